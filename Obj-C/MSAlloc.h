@@ -0,0 +1,115 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Memory allocation hooks for the buffers allocated by the Objective-C wrapper.
+ *
+ * `free_fn` is only ever called with pointers returned by `malloc_fn`, with the same
+ * `opq` pointer. Buffers allocated by the Moodstocks SDK itself, e.g. the warped
+ * pixels returned by `ms_color_img_warp`, are not affected.
+ */
+typedef struct {
+    void *(*malloc_fn)(size_t size, void *opq);
+    void (*free_fn)(void *ptr, void *opq);
+    void *opq;
+} MSAllocator;
+
+/** Set the allocator used by the wrapper.
+ *
+ * It must be set before any other wrapper call, e.g. to serve the allocations from an
+ * application pool. This function is not thread-safe: it must not be called while
+ * another thread may allocate or free memory through the wrapper.
+ *
+ * The change is refused while buffers allocated with the current allocator are
+ * still live, since they would be handed over to the new `free_fn`.
+ *
+ * @param allocator the allocator to use, or `NULL` to use the system allocator.
+ * @return 0 if the allocator has been changed, 1 otherwise.
+ */
+int MSSetAllocator(const MSAllocator *allocator);
+
+/** Get the number of allocations performed with `MSMalloc` so far, e.g. to check that
+ * a code path does not allocate once warmed up.
+ *
+ * @return the number of successful allocations since the application started.
+ */
+int64_t MSAllocCount(void);
+
+/** Allocate memory with the current allocator.
+ *
+ * @param size the number of bytes to allocate.
+ * @return the allocated memory, or `NULL` if the allocation failed.
+ */
+void *MSMalloc(size_t size);
+
+/** Free memory allocated with `MSMalloc`.
+ *
+ * @param ptr the memory to free, or `NULL`.
+ */
+void MSFree(void *ptr);
+
+/** A bump allocator for short-lived scratch buffers.
+ *
+ * Allocations are served in constant time by moving a cursor within a single block
+ * of memory, and are all released at once by `MSArenaReset`, e.g. at the end of
+ * each frame. The block is resized on reset to fit the largest demand seen so far,
+ * so that after the first frames no more memory is allocated. Arenas are not
+ * thread-safe.
+ */
+typedef struct {
+    unsigned char *base;
+    size_t size;
+    size_t used;
+    size_t demand;      /* bytes requested since the last reset, served or not */
+} MSArena;
+
+/** Initialize an empty arena. Its memory is allocated on first use.
+ *
+ * @param arena the arena.
+ */
+void MSArenaInit(MSArena *arena);
+
+/** Allocate memory from an arena.
+ *
+ * @param arena the arena.
+ * @param size the number of bytes to allocate.
+ * @return the allocated memory, aligned on 16 bytes, or `NULL` if the arena is
+ * exhausted. In the latter case, fall back to `MSMalloc`: the arena will be large
+ * enough after the next reset.
+ */
+void *MSArenaAlloc(MSArena *arena, size_t size);
+
+/** Release all the memory allocated from an arena, keeping it for reuse, and grow
+ * the arena if it has been exhausted since the previous reset.
+ *
+ * @param arena the arena.
+ */
+void MSArenaReset(MSArena *arena);
+
+/** Free the memory of an arena.
+ *
+ * @param arena the arena.
+ */
+void MSArenaDestroy(MSArena *arena);
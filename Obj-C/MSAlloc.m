@@ -0,0 +1,107 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "MSAlloc.h"
+
+#include <libkern/OSAtomic.h>
+#include <stdlib.h>
+
+static void *ms_system_malloc(size_t size, void *opq) {
+    return malloc(size);
+}
+
+static void ms_system_free(void *ptr, void *opq) {
+    free(ptr);
+}
+
+static MSAllocator gMSAllocator = {ms_system_malloc, ms_system_free, NULL};
+static volatile int64_t gMSAllocCount = 0;
+static volatile int64_t gMSAllocLive = 0;
+
+int MSSetAllocator(const MSAllocator *allocator) {
+    if (gMSAllocLive != 0)
+        return 1;
+    if (allocator && allocator->malloc_fn && allocator->free_fn) {
+        gMSAllocator = *allocator;
+    }
+    else {
+        gMSAllocator.malloc_fn = ms_system_malloc;
+        gMSAllocator.free_fn = ms_system_free;
+        gMSAllocator.opq = NULL;
+    }
+    return 0;
+}
+
+int64_t MSAllocCount(void) {
+    return gMSAllocCount;
+}
+
+void *MSMalloc(size_t size) {
+    void *ptr = gMSAllocator.malloc_fn(size, gMSAllocator.opq);
+    if (ptr) {
+        OSAtomicIncrement64(&gMSAllocCount);
+        OSAtomicIncrement64(&gMSAllocLive);
+    }
+    return ptr;
+}
+
+void MSFree(void *ptr) {
+    if (ptr) {
+        gMSAllocator.free_fn(ptr, gMSAllocator.opq);
+        OSAtomicDecrement64(&gMSAllocLive);
+    }
+}
+
+void MSArenaInit(MSArena *arena) {
+    arena->base = NULL;
+    arena->size = 0;
+    arena->used = 0;
+    arena->demand = 0;
+}
+
+void *MSArenaAlloc(MSArena *arena, size_t size) {
+    size = (size + 15) & ~(size_t) 15;
+
+    arena->demand += size;
+    if (arena->used + size > arena->size)
+        return NULL;
+
+    void *ptr = arena->base + arena->used;
+    arena->used += size;
+    return ptr;
+}
+
+void MSArenaReset(MSArena *arena) {
+    if (arena->demand > arena->size) {
+        MSFree(arena->base);
+        arena->base = MSMalloc(arena->demand);
+        arena->size = arena->base ? arena->demand : 0;
+    }
+    arena->used = 0;
+    arena->demand = 0;
+}
+
+void MSArenaDestroy(MSArena *arena) {
+    MSFree(arena->base);
+    MSArenaInit(arena);
+}
@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+
+#import "MSScanner.h"
+#import "MSImage.h"
+#import "MSResult.h"
+
+/** A provider of server-side image matching.
+ *
+ * By default, `[MSScanner apiSearch:withDelegate:]` sends the query to the
+ * Moodstocks API. Set `[MSScanner apiBackend]` to route the queries to another
+ * backend instead, e.g. `MSMockApiBackend` to measure the application behavior
+ * under controlled network conditions.
+ */
+@protocol MSApiBackend <NSObject>
+
+/** Perform a server-side image search.
+ *
+ * This method is called synchronously from a background thread, and must be
+ * thread-safe.
+ *
+ * @param qry the query image.
+ * @param scanner the scanner performing the search.
+ * @param token an opaque object identifying this search, passed back to
+ * `cancelSearch:` to abort it.
+ * @param error the pointer to the error object, if any.
+ * @return the result if any, `nil` otherwise.
+ */
+- (MSResult *)search:(MSImage *)qry scanner:(MSScanner *)scanner token:(id)token error:(NSError **)error;
+
+@optional
+
+/** Abort a pending search as soon as possible. The other searches are left untouched.
+ *
+ * This method may be called from any thread, before, while or after the search runs.
+ * The aborted search may return with any result or error: it is ignored.
+ *
+ * @param token the token of the search to abort.
+ */
+- (void)cancelSearch:(id)token;
+
+@end
+
+/** A stand-in for the Moodstocks API with injectable latency and errors.
+ *
+ * Each search waits for `latency` seconds, then fails with `errorCode` with a
+ * `failureRate` probability, or returns the next of the canned `results`.
+ */
+@interface MSMockApiBackend : NSObject <MSApiBackend> {
+    NSArray *_results;
+    NSUInteger _next;
+    NSTimeInterval _latency;
+    NSTimeInterval _jitter;
+    float _failureRate;
+    int _errorCode;
+    NSMutableSet *_pending;
+    NSMutableSet *_cancelled;
+    NSCondition *_condition;
+}
+
+/** The results returned in turn by the searches. An `NSNull` item, or an empty
+ * array, makes a search return no result.
+ */
+@property (nonatomic, copy) NSArray *results;
+/** The time taken by each search, in seconds. By default, this value is set to 0.
+ */
+@property (nonatomic, assign) NSTimeInterval latency;
+/** The maximum random time added to `latency`, in seconds. By default, this value is
+ * set to 0.
+ */
+@property (nonatomic, assign) NSTimeInterval jitter;
+/** The probability for a search to fail, in the [0..1] range. By default, this value
+ * is set to 0.
+ */
+@property (nonatomic, assign) float failureRate;
+/** The error code of the failed searches. By default, this value is set to
+ * `MS_NOCONN`.
+ */
+@property (nonatomic, assign) int errorCode;
+
+@end
@@ -0,0 +1,124 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "MSApiBackend.h"
+#import "MSObjC.h"
+
+#include <stdlib.h>
+
+@implementation MSMockApiBackend
+
+@synthesize latency = _latency;
+@synthesize jitter = _jitter;
+@synthesize failureRate = _failureRate;
+@synthesize errorCode = _errorCode;
+
+- (id)init {
+    self = [super init];
+    if (self) {
+        _results = nil;
+        _next = 0;
+        _latency = 0;
+        _jitter = 0;
+        _failureRate = 0;
+        _errorCode = MS_NOCONN;
+        _pending = [[NSMutableSet alloc] init];
+        _cancelled = [[NSMutableSet alloc] init];
+        _condition = [[NSCondition alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_results release_stub];
+    _results = nil;
+    [_pending release_stub];
+    _pending = nil;
+    [_cancelled release_stub];
+    _cancelled = nil;
+    [_condition release_stub];
+    _condition = nil;
+
+#if ! __has_feature(objc_arc)
+    [super dealloc];
+#endif
+}
+
+- (NSArray *)results {
+    NSArray *results = nil;
+    [_condition lock];
+    results = [[_results retain_stub] autorelease_stub];
+    [_condition unlock];
+    return results;
+}
+
+- (void)setResults:(NSArray *)results {
+    NSArray *copy = [results copy];
+    [_condition lock];
+    [_results release_stub];
+    _results = copy;
+    _next = 0;
+    [_condition unlock];
+}
+
+- (MSResult *)search:(MSImage *)qry scanner:(MSScanner *)scanner token:(id)token error:(NSError **)error {
+    NSTimeInterval delay = _latency + _jitter * (arc4random() / (double) UINT32_MAX);
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:delay];
+    BOOL failed = (arc4random() / (double) UINT32_MAX) < _failureRate;
+    id result = nil;
+
+    [_condition lock];
+    if (token) [_pending addObject:token];
+    while (!(token && [_cancelled containsObject:token]) && [_condition waitUntilDate:deadline]);
+    BOOL cancelled = (token && [_cancelled containsObject:token]);
+    if (token) {
+        [_pending removeObject:token];
+        [_cancelled removeObject:token];
+    }
+    if (!cancelled && !failed && [_results count] > 0) {
+        result = [[[_results objectAtIndex:(_next++ % [_results count])] retain_stub] autorelease_stub];
+    }
+    [_condition unlock];
+
+    if (cancelled || failed) {
+        if (error) {
+            int code = cancelled ? MS_ABORT : _errorCode;
+            *error = [NSError errorWithDomain:@"moodstocks-sdk" code:code userInfo:nil];
+        }
+        return nil;
+    }
+
+    return (result != [NSNull null]) ? [[result copy] autorelease_stub] : nil;
+}
+
+- (void)cancelSearch:(id)token {
+    [_condition lock];
+    // Searches that are not running cannot be aborted anymore
+    if (token && [_pending containsObject:token]) {
+        [_cancelled addObject:token];
+        [_condition broadcast];
+    }
+    [_condition unlock];
+}
+
+@end
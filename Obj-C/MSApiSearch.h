@@ -35,6 +35,8 @@
     MSScanner *_scanner;
     MSImage *_query;
     ms_api_handle_t *_request;
+    BOOL _requestCancelled;
+    MSApiSearchCompletion _completion;
 #if __has_feature(objc_arc_weak)
     id<MSScannerDelegate> __weak _delegate;
 #elif __has_feature(objc_arc)
@@ -54,6 +56,11 @@
 @property (nonatomic, assign) id<MSScannerDelegate> delegate;
 #endif
 
+/** The block to call on the main thread when the search completes, in addition to
+ * the delegate.
+ */
+@property (nonatomic, copy) MSApiSearchCompletion completion;
+
 ///---------------------------------------------------------------------------------------
 /// @name Initialization Methods
 ///---------------------------------------------------------------------------------------
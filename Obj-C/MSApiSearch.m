@@ -23,17 +23,21 @@
 
 #import "MSAvailability.h"
 #import "MSApiSearch.h"
+#import "MSApiBackend.h"
 #import "MSObjC.h"
+#import "MSTrace.h"
 
 @interface MSApiSearch ()
 - (void)willSearch;
 - (void)didSearchWithResult:(MSResult *)result;
 - (void)failedToSearchWithError:(NSError *)error;
+- (void)completeWithResult:(MSResult *)result error:(NSError *)error;
 @end
 
 @implementation MSApiSearch
 
 @synthesize delegate = _delegate;
+@synthesize completion = _completion;
 
 - (id)initWithScanner:(MSScanner *)scanner query:(MSImage *)qry {
     self = [super init];
@@ -41,8 +45,9 @@
         _scanner = scanner;
         _query = [qry retain_stub];
         _request = NULL;
+        _requestCancelled = NO;
         _delegate = nil;
-        
+        _completion = nil;
     }
     return self;
 }
@@ -52,6 +57,8 @@
     [_query release_stub];
     _query = nil;
     _delegate = nil;
+    [_completion release_stub];
+    _completion = nil;
     
 #if ! __has_feature(objc_arc)
     [super dealloc];
@@ -63,9 +70,18 @@
     [self performSelectorOnMainThread:@selector(failedToSearchWithError:) withObject:error waitUntilDone:YES];
     
 #if MS_SDK_REQUIREMENTS
-    if (_request) ms_api_handle_cancel(_request);
+    // The handle goes back to the pool once the search ends: only touch it while
+    // it is still owned by this search
+    @synchronized(self) {
+        if (_request) ms_api_handle_cancel(_request);
+        _requestCancelled = YES;
+    }
 #endif
 
+    id<MSApiBackend> backend = [_scanner apiBackend];
+    if ([backend respondsToSelector:@selector(cancelSearch:)])
+        [backend cancelSearch:self];
+
     [super cancel];
 }
 
@@ -83,24 +99,52 @@
     if (![self isCancelled]) {
         [self performSelectorOnMainThread:@selector(willSearch) withObject:nil waitUntilDone:YES];
 
-        ms_result_t *res = NULL;
-        ms_errcode ecode = ms_scanner_api_handle([_scanner handle], &_request);
-        if (ecode == MS_SUCCESS)
-            ecode = ms_api_handle_search(_request, [_query image], &res);
-        
-        if (ecode == MS_SUCCESS) {
-            if (res != NULL) {
-                result = [[[MSResult alloc] initWithResult:res] autorelease_stub];
-                ms_result_del(res);
-            }
+        id<MSApiBackend> backend = [_scanner apiBackend];
+        if (backend != nil) {
+            MS_TRACE_BEGIN("api_search");
+            MS_STATS_SCANNER_BEGIN(_scanner, t0);
+            result = [backend search:_query scanner:_scanner token:self error:&error];
+            MS_STATS_SCANNER_END(_scanner, MS_STAGE_API_SEARCH, t0);
+            MS_TRACE_END("api_search");
         }
         else {
-            error = [NSError errorWithDomain:@"moodstocks-sdk" code:ecode userInfo:nil];
-        }
-        
-        if (_request != NULL) {
-            ms_api_handle_release(_request);
-            _request = NULL;
+            ms_result_t *res = NULL;
+            ms_errcode ecode = MS_SUCCESS;
+            ms_api_handle_t *request = [_scanner dequeueApiHandle:&error];
+            BOOL cancelled = NO;
+            @synchronized(self) {
+                _request = request;
+                cancelled = _requestCancelled;
+            }
+            if (cancelled) {
+                ecode = MS_ABORT;
+            }
+            else if (request != NULL) {
+                MS_TRACE_BEGIN("api_search");
+                MS_STATS_SCANNER_BEGIN(_scanner, t0);
+                ecode = ms_api_handle_search(request, [_query image], &res);
+                MS_STATS_SCANNER_END(_scanner, MS_STAGE_API_SEARCH, t0);
+                MS_TRACE_END("api_search");
+            }
+            
+            if (ecode == MS_SUCCESS) {
+                if (res != NULL) {
+                    result = [[[MSResult alloc] initWithResultNoCopy:res] autorelease_stub];
+                }
+            }
+            else {
+                error = [NSError errorWithDomain:@"moodstocks-sdk" code:ecode userInfo:nil];
+            }
+            
+            if (request != NULL) {
+                // Keep the handle, and its connection, for the next search unless
+                // this one did not end cleanly or may have been cancelled
+                @synchronized(self) {
+                    _request = NULL;
+                    cancelled = _requestCancelled;
+                }
+                [_scanner recycleApiHandle:request reusable:(ecode == MS_SUCCESS && !cancelled)];
+            }
         }
     }
 
@@ -133,12 +177,24 @@
     if ([_delegate respondsToSelector:@selector(scanner:didSearchWithResult:)]) {
         [_delegate scanner:_scanner didSearchWithResult:result];
     }
+    [self completeWithResult:result error:nil];
 }
 
 - (void)failedToSearchWithError:(NSError *)error {
     if ([_delegate respondsToSelector:@selector(scanner:failedToSearchWithError:)]) {
         [_delegate scanner:_scanner failedToSearchWithError:error];
     }
+    [self completeWithResult:nil error:error];
+}
+
+- (void)completeWithResult:(MSResult *)result error:(NSError *)error {
+    // Only report the first outcome, e.g. if cancelled once completed
+    MSApiSearchCompletion completion = _completion;
+    _completion = nil;
+    if (completion) {
+        completion(result, error);
+        [completion release_stub];
+    }
 }
 
 @end
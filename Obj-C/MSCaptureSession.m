@@ -24,6 +24,7 @@
 #import "MSCaptureSession.h"
 
 #import "MSObjC.h"
+#import "MSTrace.h"
 
 static void ms_capturesession_cleanup(void *s) {
 #if __has_feature(objc_arc)
@@ -247,7 +248,9 @@ static void ms_capturesession_cleanup(void *s) {
 - (void)captureOutput:(AVCaptureOutput *)captureOutput
 didOutputSampleBuffer:(CMSampleBufferRef)sampleBuffer
        fromConnection:(AVCaptureConnection *)connection {
+    MS_TRACE_BEGIN("frame");
     [_delegate session:self didOutputSampleBuffer:sampleBuffer];
+    MS_TRACE_END("frame");
 }
 #endif
 
@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+
+#import "MSScanner.h"
+#import "MSImage.h"
+
+/** A hedged on-device / server-side image search.
+ *
+ * The query is searched on-device right away. If no result is found within the
+ * given budget, it is also sent to Moodstocks API, and the first result found wins:
+ * the other search is cancelled or ignored. Items that are not synced yet are then
+ * recognized without sending every query to the API.
+ *
+ * You should never have to create such a search directly.
+ * Instead use the `[MSScanner cascadeSearch:options:budget:completion:]` method.
+ */
+@interface MSCascadeSearch : NSObject {
+    MSScanner *_scanner;
+    MSImage *_query;
+    int _options;
+    NSTimeInterval _budget;
+    MSApiSearchCompletion _completion;
+    NSOperation *_online;
+    NSError *_error;
+    BOOL _offlineDone;
+    BOOL _onlineDone;
+    BOOL _done;
+}
+
+/** Initialize a cascade search.
+ *
+ * @param scanner the corresponding scanner instance.
+ * @param qry the query image.
+ * @param options the on-device search options, as a bitwise-or of `ms_search_flag_t`.
+ * @param budget the time given to the on-device search before querying the API, in
+ * seconds.
+ * @return the cascade search.
+ */
+- (id)initWithScanner:(MSScanner *)scanner
+                query:(MSImage *)qry
+              options:(int)options
+               budget:(NSTimeInterval)budget;
+
+/** Start the search. This method must be called from the main thread.
+ *
+ * @param completion the block to call on the main thread with the first result
+ * found, or with no result once both searches are over.
+ */
+- (void)startWithCompletion:(MSApiSearchCompletion)completion;
+
+/** Cancel the search. The completion block is called with a cancel error unless the
+ * search is already over. This method must be called from the main thread.
+ */
+- (void)cancel;
+
+@end
@@ -0,0 +1,159 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "MSCascadeSearch.h"
+#import "MSObjC.h"
+
+@interface MSCascadeSearch ()
+- (void)offlineDidFinishWithResult:(MSResult *)result error:(NSError *)error;
+- (void)onlineDidFinishWithResult:(MSResult *)result error:(NSError *)error;
+- (void)startOnline;
+- (void)finishWithResult:(MSResult *)result error:(NSError *)error;
+@end
+
+@implementation MSCascadeSearch
+
+- (id)initWithScanner:(MSScanner *)scanner
+                query:(MSImage *)qry
+              options:(int)options
+               budget:(NSTimeInterval)budget {
+    self = [super init];
+    if (self) {
+        _scanner = [scanner retain_stub];
+        _query = [qry retain_stub];
+        _options = options;
+        _budget = budget;
+        _completion = nil;
+        _online = nil;
+        _error = nil;
+        _offlineDone = NO;
+        _onlineDone = NO;
+        _done = NO;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_scanner release_stub];
+    _scanner = nil;
+    [_query release_stub];
+    _query = nil;
+    [_completion release_stub];
+    _completion = nil;
+    [_online release_stub];
+    _online = nil;
+    [_error release_stub];
+    _error = nil;
+
+#if ! __has_feature(objc_arc)
+    [super dealloc];
+#endif
+}
+
+- (void)startWithCompletion:(MSApiSearchCompletion)completion {
+    [_completion release_stub];
+    _completion = [completion copy];
+
+    MSScanner *scanner = _scanner;
+    MSImage *qry = _query;
+    int options = _options;
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        NSError *error = nil;
+        MSResult *result = nil;
+        if (options)
+            result = [scanner search2:qry options:options error:&error];
+        else
+            result = [scanner search:qry error:&error];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self offlineDidFinishWithResult:result error:error];
+        });
+    });
+
+    dispatch_time_t when = dispatch_time(DISPATCH_TIME_NOW, (int64_t) (_budget * NSEC_PER_SEC));
+    dispatch_after(when, dispatch_get_main_queue(), ^{
+        [self startOnline];
+    });
+}
+
+- (void)cancel {
+    if (_done) return;
+    NSError *error = [NSError errorWithDomain:@"moodstocks-sdk" code:-1 /* cancel error */ userInfo:nil];
+    [self finishWithResult:nil error:error];
+}
+
+#pragma mark - Private
+
+- (void)offlineDidFinishWithResult:(MSResult *)result error:(NSError *)error {
+    _offlineDone = YES;
+    if (_done) return;
+
+    if (result != nil) {
+        [self finishWithResult:result error:nil];
+    }
+    else if (_online == nil) {
+        // Nothing found on-device: no need to wait for the budget to expire
+        [_error release_stub];
+        _error = [error retain_stub];
+        [self startOnline];
+    }
+    else if (_onlineDone) {
+        [self finishWithResult:nil error:(_error != nil) ? _error : error];
+    }
+}
+
+- (void)onlineDidFinishWithResult:(MSResult *)result error:(NSError *)error {
+    _onlineDone = YES;
+    if (_done) return;
+
+    if (result != nil || _offlineDone) {
+        [self finishWithResult:result error:error];
+    }
+    else {
+        [_error release_stub];
+        _error = [error retain_stub];
+    }
+}
+
+- (void)startOnline {
+    if (_done || _online != nil) return;
+
+    _online = [[_scanner apiSearch:_query completion:^(MSResult *result, NSError *error) {
+        [self onlineDidFinishWithResult:result error:error];
+    }] retain_stub];
+}
+
+- (void)finishWithResult:(MSResult *)result error:(NSError *)error {
+    _done = YES;
+
+    // The on-device search cannot be interrupted: its outcome is simply ignored
+    if (!_onlineDone) [_online cancel];
+
+    MSApiSearchCompletion completion = _completion;
+    _completion = nil;
+    if (completion) {
+        completion(result, error);
+        [completion release_stub];
+    }
+}
+
+@end
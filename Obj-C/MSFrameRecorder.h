@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+
+#include <stdint.h>
+
+#import "MSAvailability.h"
+
+#if MS_IPHONE_OS_REQUIREMENTS
+  #import <AVFoundation/AVFoundation.h>
+#endif
+
+#include "moodstocks_sdk.h"
+
+/** Frame recording file format.
+ *
+ * A recording starts with the `MS_FRAME_MAGIC` and `MS_FRAME_VERSION` 32-bit words,
+ * followed by the frames. Each frame is an `MSFrameHeader` followed by `size` bytes
+ * of pixels, with `bpr` bytes per row. For `MS_PIX_FMT_NV21` frames, the UV plane
+ * immediately follows the Y plane. All fields are stored in native (little-endian)
+ * byte order.
+ */
+#define MS_FRAME_MAGIC   0x5246534d /* "MSFR" */
+#define MS_FRAME_VERSION 1
+
+/** A recorded frame header.
+ */
+typedef struct {
+    int64_t timestamp;      /* presentation time, in microseconds */
+    int32_t format;         /* pixel format (see `ms_pix_fmt_t`) */
+    int32_t orientation;    /* image orientation (see `ms_ori_t`) */
+    int32_t width;
+    int32_t height;
+    int32_t bpr;
+    int32_t size;           /* number of bytes of pixels following this header */
+} MSFrameHeader;
+
+/** Get the layout of the pixels of a frame.
+ *
+ * @param format the pixel format.
+ * @param width the frame width, in pixels.
+ * @param height the frame height, in pixels.
+ * @param rowSize the pointer where to store the number of used bytes per row.
+ * @param rows the pointer where to store the number of rows, including the UV plane
+ * of `MS_PIX_FMT_NV21` frames.
+ * @return 0 if the layout is valid, 1 otherwise, e.g. for an unknown format or empty
+ * dimensions.
+ */
+int MSFrameLayout(int format, int width, int height, int *rowSize, int *rows);
+
+/** Records camera frames into a file, to replay them later (see `MSFrameReplayer`).
+ *
+ * Frames are stored raw, so that a replay feeds the scanner with the very same
+ * pixels as the live session. Only the used part of each row is kept.
+ *
+ * A recorder can be attached to a scanner session (see
+ * `[MSScannerSession frameRecorder]`) to record all the frames it receives.
+ *
+ * If a frame cannot be written, e.g. because the disk is full, the file is truncated
+ * back to the previous frame and the recorder is closed, so that the recording stays
+ * readable.
+ */
+@interface MSFrameRecorder : NSObject {
+    FILE *_file;
+    NSUInteger _frameCount;
+}
+
+/** The number of frames recorded so far.
+ */
+@property (nonatomic, readonly) NSUInteger frameCount;
+
+/** Create a recording file.
+ *
+ * @param path the path of the file to create. Any existing file is overwritten.
+ * @param error the pointer to an error object, if any.
+ * @return the recorder instance, or `nil` if the file could not be created.
+ */
+- (id)initWithPath:(NSString *)path error:(NSError **)error;
+
+/** Record a frame.
+ *
+ * @param data the frame pixels.
+ * @param width the frame width, in pixels.
+ * @param height the frame height, in pixels.
+ * @param bpr the number of bytes per row.
+ * @param format the pixel format.
+ * @param orientation the frame orientation.
+ * @param timestamp the frame time, in microseconds.
+ * @return `YES` if the frame has been written, `NO` otherwise.
+ */
+- (BOOL)recordData:(const void *)data
+             width:(int)width
+            height:(int)height
+       bytesPerRow:(int)bpr
+            format:(ms_pix_fmt_t)format
+       orientation:(ms_ori_t)orientation
+         timestamp:(int64_t)timestamp;
+
+#if MS_IPHONE_OS_REQUIREMENTS
+/** Record a camera frame.
+ *
+ * @param buf the camera sample buffer, of type `kCVPixelFormatType_32BGRA`.
+ * @param orientation the orientation used to rotate the frame.
+ * @return `YES` if the frame has been written, `NO` otherwise.
+ */
+- (BOOL)recordBuffer:(CMSampleBufferRef)buf orientation:(AVCaptureVideoOrientation)orientation;
+#endif
+
+/** Flush and close the recording file. Subsequent frames are ignored.
+ */
+- (void)close;
+
+@end
@@ -0,0 +1,168 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "MSFrameRecorder.h"
+#import "MSImage.h"
+#import "MSObjC.h"
+
+#include <limits.h>
+#include <unistd.h>
+
+int MSFrameLayout(int format, int width, int height, int *rowSize, int *rows) {
+    if (width <= 0 || height <= 0) return 1;
+    int64_t w, h;
+    switch (format) {
+        case MS_PIX_FMT_RGB32:
+            w = 4 * (int64_t) width;
+            h = height;
+            break;
+
+        case MS_PIX_FMT_GRAY8:
+            w = width;
+            h = height;
+            break;
+
+        case MS_PIX_FMT_NV21:
+            w = width;
+            h = height + ((int64_t) height + 1) / 2;
+            break;
+
+        default:
+            return 1;
+    }
+    // Frame sizes are stored on 32 bits
+    if (w * h > INT32_MAX) return 1;
+    *rowSize = (int) w;
+    *rows = (int) h;
+    return 0;
+}
+
+@implementation MSFrameRecorder
+
+@synthesize frameCount = _frameCount;
+
+- (id)initWithPath:(NSString *)path error:(NSError **)error {
+    self = [super init];
+    if (self) {
+        _frameCount = 0;
+        _file = fopen([path fileSystemRepresentation], "wb");
+        uint32_t header[2] = {MS_FRAME_MAGIC, MS_FRAME_VERSION};
+        if (!_file || fwrite(header, sizeof(header), 1, _file) != 1) {
+            if (error) {
+                *error = [NSError errorWithDomain:@"moodstocks-sdk" code:MS_NOPERM userInfo:nil];
+            }
+            [self release_stub];
+            return nil;
+        }
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [self close];
+
+#if ! __has_feature(objc_arc)
+    [super dealloc];
+#endif
+}
+
+- (BOOL)recordData:(const void *)data
+             width:(int)width
+            height:(int)height
+       bytesPerRow:(int)bpr
+            format:(ms_pix_fmt_t)format
+       orientation:(ms_ori_t)orientation
+         timestamp:(int64_t)timestamp {
+    int rowSize, rows;
+    if (MSFrameLayout(format, width, height, &rowSize, &rows) != 0 || bpr < rowSize)
+        return NO;
+
+    @synchronized(self) {
+        if (!_file) return NO;
+        off_t start = ftello(_file);
+
+        MSFrameHeader hdr;
+        hdr.timestamp = timestamp;
+        hdr.format = format;
+        hdr.orientation = orientation;
+        hdr.width = width;
+        hdr.height = height;
+        hdr.bpr = rowSize;
+        hdr.size = rowSize * rows;
+
+        BOOL ok = (fwrite(&hdr, sizeof(hdr), 1, _file) == 1);
+        if (ok && bpr == rowSize) {
+            ok = (fwrite(data, hdr.size, 1, _file) == 1);
+        }
+        else {
+            const unsigned char *src = data;
+            for (int i = 0; ok && i < rows; i++, src += bpr)
+                ok = (fwrite(src, rowSize, 1, _file) == 1);
+        }
+        if (ok) {
+            _frameCount++;
+        }
+        else {
+            // Drop the partial frame, and stop there since the next writes would
+            // most likely fail the same way
+            fflush(_file);
+            if (start >= 0) ftruncate(fileno(_file), start);
+            fclose(_file);
+            _file = NULL;
+        }
+        return ok;
+    }
+}
+
+#if MS_IPHONE_OS_REQUIREMENTS
+- (BOOL)recordBuffer:(CMSampleBufferRef)buf orientation:(AVCaptureVideoOrientation)orientation {
+    CVImageBufferRef imageBuffer = CMSampleBufferGetImageBuffer(buf);
+
+    if (CVPixelBufferGetPixelFormatType(imageBuffer) != kCVPixelFormatType_32BGRA)
+        return NO;
+
+    CMTime pts = CMSampleBufferGetPresentationTimeStamp(buf);
+    int64_t timestamp = CMTIME_IS_VALID(pts) ? (int64_t) (CMTimeGetSeconds(pts) * 1e6) : 0;
+
+    CVPixelBufferLockBaseAddress(imageBuffer, 0);
+    BOOL ok = [self recordData:CVPixelBufferGetBaseAddress(imageBuffer)
+                         width:(int) CVPixelBufferGetWidth(imageBuffer)
+                        height:(int) CVPixelBufferGetHeight(imageBuffer)
+                   bytesPerRow:(int) CVPixelBufferGetBytesPerRow(imageBuffer)
+                        format:MS_PIX_FMT_RGB32
+                   orientation:MSOrientationFromVideoOrientation(orientation)
+                     timestamp:timestamp];
+    CVPixelBufferUnlockBaseAddress(imageBuffer, 0);
+
+    return ok;
+}
+#endif
+
+- (void)close {
+    @synchronized(self) {
+        if (_file) fclose(_file);
+        _file = NULL;
+    }
+}
+
+@end
@@ -0,0 +1,186 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+
+#import "MSAvailability.h"
+#import "MSScanner.h"
+#import "MSFrameRecorder.h"
+
+/** The outcome of a replay.
+ */
+@interface MSReplayReport : NSObject {
+    NSMutableArray *_results;
+    NSMutableData *_latencies;
+    NSTimeInterval _duration;
+    int _flags;
+    size_t _residentSize;
+    unsigned long long _queryBytes;
+    int64_t _steadyAllocations;
+}
+
+/** The number of replayed frames.
+ */
+@property (nonatomic, readonly) NSUInteger frameCount;
+/** The number of frames that led to a result.
+ */
+@property (nonatomic, readonly) NSUInteger resultCount;
+/** The result of each frame, in order, or `NSNull` if it led to no result.
+ */
+@property (nonatomic, readonly) NSArray *results;
+/** The total replay time, in seconds, including the time spent reading the frames.
+ */
+@property (nonatomic, readonly) NSTimeInterval duration;
+/** The number of frames replayed per second.
+ */
+@property (nonatomic, readonly) double throughput;
+/** The image search options used for the replay, as a bitwise-or of `ms_search_flag_t`.
+ */
+@property (nonatomic, readonly) int flags;
+/** The resident memory size of the application at the end of the replay, in bytes,
+ * or 0 if it is unknown.
+ */
+@property (nonatomic, readonly) size_t residentSize;
+/** The total size of the query images sent to Moodstocks API, in bytes, before the
+ * encoding performed by the SDK, or 0 for an on-device replay.
+ */
+@property (nonatomic, readonly) unsigned long long queryBytes;
+/** The number of buffers allocated through `MSMalloc` while replaying all the frames
+ * but the first one, which warms the scratch buffers up.
+ *
+ * It is 0 when the per-frame path of the wrapper does not allocate any memory. The
+ * count is process-wide, so make sure nothing else runs during the replay. The
+ * allocations made by the Moodstocks SDK itself and the Objective-C objects are not
+ * counted.
+ */
+@property (nonatomic, readonly) int64_t steadyAllocations;
+
+/** Get the latency of a frame.
+ *
+ * The latency covers the conversion of the frame into a scanner image and its scan.
+ *
+ * @param index the frame index.
+ * @return the frame latency, in seconds.
+ */
+- (NSTimeInterval)latencyAtIndex:(NSUInteger)index;
+
+/** Get the median, or any other percentile, of the frame latencies.
+ *
+ * @param p the percentile, in the [0..1] range.
+ * @return the latency percentile, in seconds.
+ */
+- (NSTimeInterval)latencyPercentile:(float)p;
+
+/** Get the ratio of frames that led to the expected result.
+ *
+ * @param expectedIDs the expected result value (see `[MSResult getValue]`) of each
+ * frame, in order, or `NSNull` for frames that should lead to no result. Frames
+ * without any expected result are not counted.
+ * @return the recall, in the [0..1] range, or 0 if no result is expected.
+ */
+- (float)recallWithExpectedIDs:(NSArray *)expectedIDs;
+
+@end
+
+/** Replays frames recorded with `MSFrameRecorder` through a scanner.
+ *
+ * The frames are scanned the same way a scanner session does: image recognition
+ * first, then barcode decoding if no image has been found. This gives reproducible
+ * latency and accuracy numbers without any camera, e.g. to compare two versions of
+ * an application on the same device.
+ *
+ * Replays are synchronous: run them on a background thread.
+ */
+@interface MSFrameReplayer : NSObject {
+    NSString *_path;
+}
+
+/** Initialize a replayer.
+ *
+ * @param path the path of the recording file.
+ * @return the replayer instance.
+ */
+- (id)initWithPath:(NSString *)path;
+
+/** Replay all the recorded frames as fast as possible.
+ *
+ * @param scanner the scanner to use, which must be opened.
+ * @param options the scan options as a bitwise-or of scanning types (see `MSResult`).
+ * @param flags the image search options, as a bitwise-or of `ms_search_flag_t`.
+ * @param error the pointer to an error object, if any.
+ * @return the replay report, or `nil` if the recording could not be read or a scan
+ * failed.
+ */
+- (MSReplayReport *)replayWithScanner:(MSScanner *)scanner
+                              options:(int)options
+                                flags:(int)flags
+                                error:(NSError **)error;
+
+/** Same as above, with the option to pace the frames as they were recorded.
+ *
+ * @param scanner the scanner to use, which must be opened.
+ * @param options the scan options as a bitwise-or of scanning types (see `MSResult`).
+ * @param flags the image search options, as a bitwise-or of `ms_search_flag_t`.
+ * @param realTime `YES` to wait between frames according to their timestamps, `NO`
+ * to replay them as fast as possible.
+ * @param error the pointer to an error object, if any.
+ * @return the replay report, or `nil` if the recording could not be read or a scan
+ * failed.
+ */
+- (MSReplayReport *)replayWithScanner:(MSScanner *)scanner
+                              options:(int)options
+                                flags:(int)flags
+                             realTime:(BOOL)realTime
+                                error:(NSError **)error;
+
+/** Replay all the recorded frames once per image search options combination.
+ *
+ * Use it to measure the latency, throughput, memory and recall cost of
+ * `MS_SEARCH_NOPARTIAL` and `MS_SEARCH_SMALLTARGET` on a given database.
+ *
+ * @param scanner the scanner to use, which must be opened.
+ * @param error the pointer to an error object, if any.
+ * @return the replay reports of the image search with no option,
+ * `MS_SEARCH_NOPARTIAL`, `MS_SEARCH_SMALLTARGET` and both options, in this order,
+ * or `nil` if a replay failed.
+ */
+- (NSArray *)benchmarkWithScanner:(MSScanner *)scanner error:(NSError **)error;
+
+/** Send all the recorded frames to Moodstocks API, once at full size and once as
+ * compact queries (see `[MSScannerSession compactApiQuery]`).
+ *
+ * Use it to measure the latency and payload gain of compact queries on a given
+ * network. Frames too small to be halved are sent at full size in both passes,
+ * exactly as the scanner session does. The searches go through
+ * `[MSScanner apiBackend]` if set.
+ *
+ * @param scanner the scanner to use, which must be opened.
+ * @param error the pointer to an error object, if any.
+ * @return the replay reports of the full size and compact queries, in this order,
+ * or `nil` if a replay failed.
+ *
+ * @warning **Note:** this method requires an Internet connection.
+ */
+- (NSArray *)apiBenchmarkWithScanner:(MSScanner *)scanner error:(NSError **)error;
+
+@end
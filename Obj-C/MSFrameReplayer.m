@@ -0,0 +1,458 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "MSFrameReplayer.h"
+#import "MSImage.h"
+#import "MSStats.h"
+#import "MSApiBackend.h"
+#import "MSObjC.h"
+
+#include <mach/mach.h>
+
+// Largest accepted frame payload, in bytes (1280x720 at 32 bpp)
+static const int32_t kMSMaxFrameSize = 1280 * 720 * 4;
+
+@interface MSReplayReport ()
+- (void)addResult:(MSResult *)result latency:(NSTimeInterval)latency;
+- (void)setDuration:(NSTimeInterval)duration;
+- (void)setFlags:(int)flags;
+- (void)addQueryBytes:(unsigned long long)bytes;
+- (void)setSteadyAllocations:(int64_t)count;
+@end
+
+/** How the replayed frames are searched.
+ */
+typedef enum {
+    MS_REPLAY_ON_DEVICE = 0,
+    MS_REPLAY_API,
+    MS_REPLAY_API_COMPACT
+} MSReplayMode;
+
+static size_t ms_resident_size(void) {
+    struct task_basic_info info;
+    mach_msg_type_number_t count = TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), TASK_BASIC_INFO, (task_info_t) &info, &count) != KERN_SUCCESS)
+        return 0;
+    return info.resident_size;
+}
+
+@implementation MSReplayReport
+
+@synthesize results = _results;
+@synthesize duration = _duration;
+@synthesize flags = _flags;
+@synthesize residentSize = _residentSize;
+@synthesize queryBytes = _queryBytes;
+@synthesize steadyAllocations = _steadyAllocations;
+
+- (id)init {
+    self = [super init];
+    if (self) {
+        _results = [[NSMutableArray alloc] init];
+        _latencies = [[NSMutableData alloc] init];
+        _duration = 0;
+        _flags = 0;
+        _residentSize = 0;
+        _queryBytes = 0;
+        _steadyAllocations = 0;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_results release_stub];
+    [_latencies release_stub];
+    _results = nil;
+    _latencies = nil;
+
+#if ! __has_feature(objc_arc)
+    [super dealloc];
+#endif
+}
+
+- (NSUInteger)frameCount {
+    return [_results count];
+}
+
+- (NSUInteger)resultCount {
+    NSUInteger count = 0;
+    for (id result in _results) {
+        if (result != [NSNull null]) count++;
+    }
+    return count;
+}
+
+- (double)throughput {
+    return (_duration > 0) ? [_results count] / _duration : 0;
+}
+
+- (NSTimeInterval)latencyAtIndex:(NSUInteger)index {
+    if (index >= [_results count]) return 0;
+    return ((const NSTimeInterval *) [_latencies bytes])[index];
+}
+
+static int ms_replay_cmp(const void *a, const void *b) {
+    NSTimeInterval x = *(const NSTimeInterval *) a;
+    NSTimeInterval y = *(const NSTimeInterval *) b;
+    return (x > y) - (x < y);
+}
+
+- (NSTimeInterval)latencyPercentile:(float)p {
+    NSUInteger n = [_results count];
+    if (n == 0) return 0;
+
+    NSMutableData *sorted = [NSMutableData dataWithData:_latencies];
+    NSTimeInterval *values = [sorted mutableBytes];
+    qsort(values, n, sizeof(NSTimeInterval), ms_replay_cmp);
+
+    p = MAX(0, MIN(1, p));
+    NSUInteger rank = (NSUInteger) ceilf(p * n);
+    return values[(rank > 0) ? rank - 1 : 0];
+}
+
+- (float)recallWithExpectedIDs:(NSArray *)expectedIDs {
+    NSUInteger expected = 0;
+    NSUInteger found = 0;
+    NSUInteger n = MIN([expectedIDs count], [_results count]);
+    for (NSUInteger i = 0; i < n; i++) {
+        id value = [expectedIDs objectAtIndex:i];
+        if (value == [NSNull null]) continue;
+        expected++;
+        id result = [_results objectAtIndex:i];
+        if (result != [NSNull null] && [[result getValue] isEqualToString:value])
+            found++;
+    }
+    return (expected > 0) ? (float) found / expected : 0;
+}
+
+- (void)addResult:(MSResult *)result latency:(NSTimeInterval)latency {
+    [_results addObject:(result != nil) ? (id) result : (id) [NSNull null]];
+    [_latencies appendBytes:&latency length:sizeof(latency)];
+}
+
+- (void)setDuration:(NSTimeInterval)duration {
+    _duration = duration;
+    _residentSize = ms_resident_size();
+}
+
+- (void)setFlags:(int)flags {
+    _flags = flags;
+}
+
+- (void)addQueryBytes:(unsigned long long)bytes {
+    _queryBytes += bytes;
+}
+
+- (void)setSteadyAllocations:(int64_t)count {
+    _steadyAllocations = count;
+}
+
+@end
+
+@interface MSFrameReplayer ()
+- (MSResult *)scan:(MSImage *)qry
+           scanner:(MSScanner *)scanner
+           options:(int)options
+             flags:(int)flags
+             error:(NSError **)error;
+- (MSResult *)apiSearch:(MSImage *)qry scanner:(MSScanner *)scanner error:(NSError **)error;
+- (MSReplayReport *)replayWithScanner:(MSScanner *)scanner
+                              options:(int)options
+                                flags:(int)flags
+                             realTime:(BOOL)realTime
+                                 mode:(MSReplayMode)mode
+                                error:(NSError **)error;
+@end
+
+@implementation MSFrameReplayer
+
+- (id)initWithPath:(NSString *)path {
+    self = [super init];
+    if (self) {
+        _path = [path copy];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_path release_stub];
+    _path = nil;
+
+#if ! __has_feature(objc_arc)
+    [super dealloc];
+#endif
+}
+
+- (MSReplayReport *)replayWithScanner:(MSScanner *)scanner
+                              options:(int)options
+                                flags:(int)flags
+                                error:(NSError **)error {
+    return [self replayWithScanner:scanner options:options flags:flags realTime:NO error:error];
+}
+
+- (MSReplayReport *)replayWithScanner:(MSScanner *)scanner
+                              options:(int)options
+                                flags:(int)flags
+                             realTime:(BOOL)realTime
+                                error:(NSError **)error {
+    return [self replayWithScanner:scanner options:options flags:flags realTime:realTime
+                              mode:MS_REPLAY_ON_DEVICE error:error];
+}
+
+- (MSReplayReport *)replayWithScanner:(MSScanner *)scanner
+                              options:(int)options
+                                flags:(int)flags
+                             realTime:(BOOL)realTime
+                                 mode:(MSReplayMode)mode
+                                error:(NSError **)error {
+    FILE *f = fopen([_path fileSystemRepresentation], "rb");
+    if (!f) {
+        if (error) {
+            *error = [NSError errorWithDomain:@"moodstocks-sdk" code:MS_NOFILE userInfo:nil];
+        }
+        return nil;
+    }
+
+    ms_errcode ecode = MS_SUCCESS;
+    uint32_t magic[2];
+    if (fread(magic, sizeof(magic), 1, f) != 1 ||
+        magic[0] != MS_FRAME_MAGIC || magic[1] != MS_FRAME_VERSION) {
+        ecode = MS_CORRUPT;
+    }
+
+    MSReplayReport *report = [[[MSReplayReport alloc] init] autorelease_stub];
+    [report setFlags:flags];
+    NSMutableData *pixels = [NSMutableData data];
+    NSError *scanError = nil;
+    NSDate *start = [NSDate date];
+    int64_t firstTimestamp = 0;
+    int64_t allocBase = -1;
+    MSArena arena;
+    MSArenaInit(&arena);
+    MSFrameHeader hdr;
+
+    while (ecode == MS_SUCCESS && fread(&hdr, sizeof(hdr), 1, f) == 1) {
+        // Same as `MSScannerSession`: scratch buffers only live for one frame
+        MSArenaReset(&arena);
+        if (allocBase < 0 && [report frameCount] > 0)
+            allocBase = MSAllocCount();
+
+        // Never trust the header: the scanner reads `bpr` bytes for each row
+        int rowSize, rows;
+        if (hdr.format < 0 || hdr.format >= MS_PIX_FMT_NB ||
+            MSFrameLayout(hdr.format, hdr.width, hdr.height, &rowSize, &rows) != 0 ||
+            hdr.bpr < rowSize || hdr.size <= 0 || hdr.size > kMSMaxFrameSize ||
+            hdr.size < (int64_t) hdr.bpr * rows) {
+            ecode = MS_CORRUPT;
+            break;
+        }
+        [pixels setLength:hdr.size];
+        if (fread([pixels mutableBytes], hdr.size, 1, f) != 1) {
+            ecode = MS_CORRUPT;
+            break;
+        }
+
+        if (realTime) {
+            if ([report frameCount] == 0) firstTimestamp = hdr.timestamp;
+            NSTimeInterval due = (hdr.timestamp - firstTimestamp) / 1e6;
+            NSTimeInterval wait = due + [start timeIntervalSinceNow];
+            if (wait > 0) [NSThread sleepForTimeInterval:wait];
+        }
+
+#if __has_feature(objc_arc)
+        @autoreleasepool {
+#else
+        NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+#endif
+
+        uint64_t t0 = MSStatsNow();
+        MSImage *qry = nil;
+        if (mode == MS_REPLAY_API_COMPACT && hdr.format == MS_PIX_FMT_RGB32) {
+            qry = [[MSImage alloc] initWithHalfSizeData:[pixels bytes]
+                                                  width:hdr.width
+                                                 height:hdr.height
+                                            bytesPerRow:hdr.bpr
+                                            orientation:hdr.orientation
+                                                  arena:&arena];
+        }
+        else {
+            qry = [[MSImage alloc] initWithData:[pixels bytes]
+                                          width:hdr.width
+                                         height:hdr.height
+                                    bytesPerRow:hdr.bpr
+                                         format:hdr.format
+                                    orientation:hdr.orientation];
+        }
+        MSResult *result = nil;
+        if ([qry image] != NULL) {
+            if (mode == MS_REPLAY_ON_DEVICE) {
+                result = [self scan:qry scanner:scanner options:options flags:flags error:&scanError];
+            }
+            else {
+                // Scanner images hold 8-bit luminance whatever the input format
+                unsigned long long w = hdr.width, h = hdr.height;
+                if (mode == MS_REPLAY_API_COMPACT && hdr.format == MS_PIX_FMT_RGB32 &&
+                    MAX(w, h) / 2 >= 480) {
+                    w /= 2;
+                    h /= 2;
+                }
+                [report addQueryBytes:w * h];
+                result = [self apiSearch:qry scanner:scanner error:&scanError];
+            }
+            [report addResult:result latency:(MSStatsNow() - t0) / 1e6];
+        }
+        else {
+            ecode = MS_IMG;
+        }
+        [qry release_stub];
+        [scanError retain_stub];
+
+#if __has_feature(objc_arc)
+        } /* end of @autoreleasepool block */
+#else
+        [pool release];
+#endif
+
+        [scanError autorelease_stub];
+        if (scanError) break;
+    }
+
+    fclose(f);
+    [report setDuration:-[start timeIntervalSinceNow]];
+    [report setSteadyAllocations:(allocBase >= 0) ? MSAllocCount() - allocBase : 0];
+    MSArenaDestroy(&arena);
+
+    if (ecode != MS_SUCCESS) {
+        if (error) {
+            *error = [NSError errorWithDomain:@"moodstocks-sdk" code:ecode userInfo:nil];
+        }
+        return nil;
+    }
+    if (scanError) {
+        if (error) *error = scanError;
+        return nil;
+    }
+
+    return report;
+}
+
+- (NSArray *)apiBenchmarkWithScanner:(MSScanner *)scanner error:(NSError **)error {
+    NSMutableArray *reports = [NSMutableArray array];
+    MSReplayMode modes[] = {MS_REPLAY_API, MS_REPLAY_API_COMPACT};
+    for (int i = 0; i < 2; i++) {
+        MSReplayReport *report = [self replayWithScanner:scanner
+                                                 options:MS_RESULT_TYPE_IMAGE
+                                                   flags:MS_SEARCH_DEFAULT
+                                                realTime:NO
+                                                    mode:modes[i]
+                                                   error:error];
+        if (report == nil) return nil;
+        [reports addObject:report];
+    }
+    return reports;
+}
+
+- (NSArray *)benchmarkWithScanner:(MSScanner *)scanner error:(NSError **)error {
+    static const int kFlags[] = {
+        MS_SEARCH_DEFAULT,
+        MS_SEARCH_NOPARTIAL,
+        MS_SEARCH_SMALLTARGET,
+        MS_SEARCH_NOPARTIAL | MS_SEARCH_SMALLTARGET
+    };
+
+    NSMutableArray *reports = [NSMutableArray array];
+    for (int i = 0; i < 4; i++) {
+        MSReplayReport *report = [self replayWithScanner:scanner
+                                                 options:MS_RESULT_TYPE_IMAGE
+                                                   flags:kFlags[i]
+                                                   error:error];
+        if (report == nil) return nil;
+        [reports addObject:report];
+    }
+    return reports;
+}
+
+#pragma mark - Private
+
+- (MSResult *)scan:(MSImage *)qry
+           scanner:(MSScanner *)scanner
+           options:(int)options
+             flags:(int)flags
+             error:(NSError **)error {
+    MSResult *result = nil;
+    NSError *err = nil;
+
+    if (options & MS_RESULT_TYPE_IMAGE) {
+        if (flags)
+            result = [scanner search2:qry options:flags error:&err];
+        else
+            result = [scanner search:qry error:&err];
+        // Same as `MSScannerSession`: an empty database is not an error
+        if (err != nil && [err code] == MS_EMPTY)
+            err = nil;
+    }
+
+    int formats = options & ~MS_RESULT_TYPE_IMAGE;
+    if (result == nil && err == nil && formats) {
+        result = [scanner decode:qry formats:formats error:&err];
+        if (err != nil && [err code] == MS_EMPTY)
+            err = nil;
+    }
+
+    if (err && error) *error = err;
+
+    return result;
+}
+
+- (MSResult *)apiSearch:(MSImage *)qry scanner:(MSScanner *)scanner error:(NSError **)error {
+    MSResult *result = nil;
+    NSError *err = nil;
+
+    id<MSApiBackend> backend = [scanner apiBackend];
+    if (backend != nil) {
+        result = [backend search:qry scanner:scanner token:self error:&err];
+    }
+#if MS_SDK_REQUIREMENTS
+    else {
+        ms_api_handle_t *handle = [scanner dequeueApiHandle:&err];
+        if (handle != NULL) {
+            ms_result_t *res = NULL;
+            ms_errcode ecode = ms_api_handle_search(handle, [qry image], &res);
+            if (ecode == MS_SUCCESS) {
+                if (res != NULL)
+                    result = [[[MSResult alloc] initWithResultNoCopy:res] autorelease_stub];
+            }
+            else {
+                err = [NSError errorWithDomain:@"moodstocks-sdk" code:ecode userInfo:nil];
+            }
+            [scanner recycleApiHandle:handle reusable:(ecode == MS_SUCCESS)];
+        }
+    }
+#endif
+
+    if (err && error) *error = err;
+
+    return result;
+}
+
+@end
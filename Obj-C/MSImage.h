@@ -29,22 +29,86 @@
 
 #include "moodstocks_sdk.h"
 
+#import "MSAlloc.h"
+
+#if MS_IPHONE_OS_REQUIREMENTS
+/** Converts a video orientation into the matching EXIF orientation of the camera frames.
+ *
+ * @param orientation the orientation used to rotate the camera frames, or -1 to keep
+ * them unchanged.
+ * @return the image orientation to pass to `ms_img_new`.
+ */
+ms_ori_t MSOrientationFromVideoOrientation(AVCaptureVideoOrientation orientation);
+#endif
+
 /** Wrapper around the Moodstocks SDK image data structure.
  */
 @interface MSImage : NSObject {
     ms_img_t *_img;
+    CGRect _region;
 }
 
 /** The internal image handle.
  */
 @property (readonly, nonatomic) ms_img_t *image;
 
+/** The region of the camera frame covered by this image, in the frame domain in its
+ * initial orientation, i.e. as the frame is **physically** provided by the camera.
+ *
+ * The region is expressed with coordinates in the [-1..1] range, and is equal to
+ * `{-1, -1, 2, 2}` unless the image has been created with a crop.
+ */
+@property (readonly, nonatomic) CGRect region;
+
 /** Initialize an image.
  *
  * @return the image instance.
  */
 - (id)init;
 
+/** Initialize an image with raw pixels, e.g. a frame previously recorded with
+ * `MSFrameRecorder`.
+ *
+ * The pixels are converted right away: they can be freed as soon as this method
+ * returns.
+ *
+ * @param data the image pixels.
+ * @param width the image width, in pixels.
+ * @param height the image height, in pixels.
+ * @param bpr the number of bytes per row.
+ * @param format the pixel format.
+ * @param orientation the orientation of the image.
+ * @return the image instance. Its `image` is `NULL` if the pixels have been rejected
+ * (see `ms_img_new`).
+ */
+- (id)initWithData:(const void *)data
+             width:(int)width
+            height:(int)height
+       bytesPerRow:(int)bpr
+            format:(ms_pix_fmt_t)format
+       orientation:(ms_ori_t)orientation;
+
+/** Initialize a half-size 8-bit grayscale image with raw 32-bit BGRA pixels, the same
+ * way as `initWithHalfSizeBuffer:orientation:`.
+ *
+ * If the half-size image would be smaller than 480 pixels in its largest dimension,
+ * the pixels are used at full size instead.
+ *
+ * @param data the image pixels.
+ * @param width the image width, in pixels.
+ * @param height the image height, in pixels.
+ * @param bpr the number of bytes per row.
+ * @param orientation the orientation of the image.
+ * @param arena the arena to take the conversion scratch buffer from, or `NULL`.
+ * @return the image instance.
+ */
+- (id)initWithHalfSizeData:(const void *)data
+                     width:(int)width
+                    height:(int)height
+               bytesPerRow:(int)bpr
+               orientation:(ms_ori_t)orientation
+                     arena:(MSArena *)arena;
+
 #if MS_IPHONE_OS_REQUIREMENTS
 /** Initialize an image with a camera buffer.
  *
@@ -62,6 +126,49 @@
 - (id)initWithBuffer:(CMSampleBufferRef)buf
          orientation:(AVCaptureVideoOrientation)orientation;
 
+/** Initialize an image with a region of a camera buffer re-oriented with input orientation.
+ *
+ * The region is taken as is, without any copy of the frame data, which makes it
+ * cheap to scan a sub-part of the frame only, e.g. where a barcode has been
+ * previously found. The results found with this image are mapped back to the
+ * whole frame domain (see `region`).
+ *
+ * @param buf the camera raw image buffer.
+ * @param orientation the orientation used to rotate the input buffer.
+ * @param crop the region to keep, in pixels, in the frame domain as physically provided
+ * by the camera. Its largest dimension *MUST* be higher than or equal to 480 pixels.
+ * @return the image instance.
+ */
+- (id)initWithBuffer:(CMSampleBufferRef)buf
+         orientation:(AVCaptureVideoOrientation)orientation
+                crop:(CGRect)crop;
+
+/** Initialize a half-size 8-bit grayscale image with a camera buffer re-oriented with
+ * input orientation.
+ *
+ * Such images are cheaper to send to Moodstocks API, e.g. over slow connections. If
+ * the half-size image would be smaller than 480 pixels in its largest dimension,
+ * the full size frame is used instead.
+ *
+ * @param buf the camera raw image buffer.
+ * @param orientation the orientation used to rotate the input buffer.
+ * @return the image instance.
+ */
+- (id)initWithHalfSizeBuffer:(CMSampleBufferRef)buf
+                 orientation:(AVCaptureVideoOrientation)orientation;
+
+/** Same as above, but takes the scratch buffer used for the conversion from an arena.
+ *
+ * @param buf the camera raw image buffer.
+ * @param orientation the orientation used to rotate the input buffer.
+ * @param arena the arena, or `NULL`. The scratch buffer is no longer needed once this
+ * method returns.
+ * @return the image instance.
+ */
+- (id)initWithHalfSizeBuffer:(CMSampleBufferRef)buf
+                 orientation:(AVCaptureVideoOrientation)orientation
+                       arena:(MSArena *)arena;
+
 /** Converts a camera sample buffer of type `kCVPixelFormatType_32BGRA` to a CGImage.
  *
  * @param buf the sample buffer to convert.
@@ -69,6 +176,28 @@
  */
 + (CGImageRef)newCGImageFromBuffer:(CMSampleBufferRef)buf;
 
+/**
+ * Warps a camera sample buffer using a perspective transform.
+ *
+ * Unlike `newWarpFromImage:data:scale:gray:` this samples the camera frame in place,
+ * without first converting it to a CGImage and copying its pixels. Use it to warp a
+ * result while its frame is still at hand: this is what `MSScannerSession` does for
+ * image results when the `MS_RESULT_EXTRA_WARPED` extra is set.
+ * @param buf the sample buffer to transform, of type `kCVPixelFormatType_32BGRA`.
+ * @param data the `ms_warp_data_t` object specifying the perspective transform and
+ * desired result dimensions.
+ * @param scale the scale factor to apply to the dimensions specified in `data`, in
+ * the [0..1] range, or a negative value to get the maximum possible resolution.
+ * @param gray `YES` to get an 8-bit grayscale image, e.g. to feed an OCR library,
+ * `NO` to get a color image.
+ * @return the warped CGImage, or `nil` if it could not be computed. The caller must
+ * manage its deletion.
+ */
++ (CGImageRef)newWarpFromBuffer:(CMSampleBufferRef)buf
+                           data:(ms_warp_data_t *)data
+                          scale:(float)scale
+                           gray:(BOOL)gray;
+
 #endif
 
 /**
@@ -103,4 +232,17 @@
  * deletion.
  */
 + (CGImageRef)newWarpFromImage:(CGImageRef)img data:(ms_warp_data_t *)data scale:(float)scale;
+
+/**
+ * Similar to the above function, with the option to get an 8-bit grayscale result.
+ * @param img the source CGImage to transform
+ * @param data the `ms_warp_data_t` object specifying the perspective transform and
+ * desired result dimensions.
+ * @param scale the scale factor to apply to the dimensions specified in `data`, in
+ * the [0..1] range, or a negative value to get the maximum possible resolution.
+ * @param gray `YES` to get an 8-bit grayscale image, `NO` to get a color image.
+ * @return the warped CGImage, or `nil` if it could not be computed. The caller must
+ * manage its deletion.
+ */
++ (CGImageRef)newWarpFromImage:(CGImageRef)img data:(ms_warp_data_t *)data scale:(float)scale gray:(BOOL)gray;
 @end
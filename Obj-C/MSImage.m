@@ -24,6 +24,23 @@
 #import "MSImage.h"
 #import "MSObjC.h"
 
+/**
+ * Creates a CGImage that takes ownership of the pixels of a color image
+ *
+ * The pixels are freed when the CGImage is released. Returns NULL, and frees
+ * nothing, if the color image is empty.
+ *
+ * The caller must manage deletion
+ */
+CGImageRef MSCreateCGImageFromColorImage(ms_color_img_t *img);
+
+/**
+ * Same as above, but converts the pixels to 8-bit grayscale first, in place
+ *
+ * The caller must manage deletion
+ */
+CGImageRef MSCreateGrayCGImageFromColorImage(ms_color_img_t *img);
+
 #if MS_IPHONE_OS_REQUIREMENTS
 /**
  * Creates an image with Moodstocks format from a camera frame buffer
@@ -42,16 +59,58 @@ ms_img_t *MSCreateImageFromSampleBuffer(CMSampleBufferRef sbuf);
  * The caller must manage deletion
  */
 ms_img_t *MSCreateImageFromSampleBuffer2(CMSampleBufferRef sbuf, AVCaptureVideoOrientation orientation);
+
+/**
+ * Same as above, but only keeps the `crop` region of the frame, in pixels. Use
+ * `CGRectNull` to keep the whole frame. The region actually kept, clamped to
+ * the frame boundaries, is stored into `region` with coordinates in the [-1..1]
+ * range, if not NULL.
+ *
+ * The caller must manage deletion
+ */
+ms_img_t *MSCreateImageFromSampleBuffer3(CMSampleBufferRef sbuf, AVCaptureVideoOrientation orientation,
+                                         CGRect crop, CGRect *region);
+
+/**
+ * Creates a half-size 8-bit grayscale image from a camera frame buffer
+ *
+ * Falls back to a full size image if the half-size one would be smaller than what
+ * the scanner accepts
+ *
+ * The caller must manage deletion
+ */
+ms_img_t *MSCreateHalfSizeImageFromSampleBuffer(CMSampleBufferRef sbuf, AVCaptureVideoOrientation orientation);
+
+/**
+ * Same as above, but takes the scratch buffer from `arena` if not NULL
+ *
+ * The caller must manage deletion
+ */
+ms_img_t *MSCreateHalfSizeImageFromSampleBufferInArena(CMSampleBufferRef sbuf, AVCaptureVideoOrientation orientation,
+                                                      MSArena *arena);
 #endif
 
+/**
+ * Creates a half-size 8-bit grayscale image from 32-bit BGRA pixels, taking the
+ * scratch buffer from `arena` if not NULL
+ *
+ * Returns NULL if the half-size image would be smaller than what the scanner accepts
+ *
+ * The caller must manage deletion
+ */
+ms_img_t *MSCreateHalfSizeImage(const unsigned char *data, int width, int height, int bpr,
+                                ms_ori_t orientation, MSArena *arena);
+
 @implementation MSImage
 
 @synthesize image = _img;
+@synthesize region = _region;
 
 - (id)init {
     self = [super init];
     if (self) {
         _img = NULL;
+        _region = CGRectMake(-1, -1, 2, 2);
     }
     return self;
 }
@@ -73,7 +132,65 @@ ms_img_t *MSCreateImageFromSampleBuffer2(CMSampleBufferRef sbuf, AVCaptureVideoO
     }
     return self;
 }
+
+- (id)initWithBuffer:(CMSampleBufferRef)buf
+         orientation:(AVCaptureVideoOrientation)orientation
+                crop:(CGRect)crop {
+    self = [self init];
+    if (self) {
+        _img = MSCreateImageFromSampleBuffer3(buf, orientation, crop, &_region);
+    }
+    return self;
+}
+
+- (id)initWithHalfSizeBuffer:(CMSampleBufferRef)buf
+                 orientation:(AVCaptureVideoOrientation)orientation {
+    return [self initWithHalfSizeBuffer:buf orientation:orientation arena:NULL];
+}
+
+- (id)initWithHalfSizeBuffer:(CMSampleBufferRef)buf
+                 orientation:(AVCaptureVideoOrientation)orientation
+                       arena:(MSArena *)arena {
+    self = [self init];
+    if (self) {
+        _img = MSCreateHalfSizeImageFromSampleBufferInArena(buf, orientation, arena);
+    }
+    return self;
+}
+#endif
+
+- (id)initWithData:(const void *)data
+             width:(int)width
+            height:(int)height
+       bytesPerRow:(int)bpr
+            format:(ms_pix_fmt_t)format
+       orientation:(ms_ori_t)orientation {
+    self = [self init];
+    if (self) {
+#if MS_SDK_REQUIREMENTS
+        if (ms_img_new(data, width, height, bpr, format, orientation, &_img) != MS_SUCCESS)
+            _img = NULL;
 #endif
+    }
+    return self;
+}
+
+- (id)initWithHalfSizeData:(const void *)data
+                     width:(int)width
+                    height:(int)height
+               bytesPerRow:(int)bpr
+               orientation:(ms_ori_t)orientation
+                     arena:(MSArena *)arena {
+    self = [self init];
+    if (self) {
+        _img = MSCreateHalfSizeImage(data, width, height, bpr, orientation, arena);
+#if MS_SDK_REQUIREMENTS
+        if (!_img && ms_img_new(data, width, height, bpr, MS_PIX_FMT_RGB32, orientation, &_img) != MS_SUCCESS)
+            _img = NULL;
+#endif
+    }
+    return self;
+}
 
 - (void)dealloc {
 #if MS_SDK_REQUIREMENTS
@@ -113,6 +230,40 @@ ms_img_t *MSCreateImageFromSampleBuffer2(CMSampleBufferRef sbuf, AVCaptureVideoO
     
     return result;
 }
+
++ (CGImageRef)newWarpFromBuffer:(CMSampleBufferRef)buf
+                           data:(ms_warp_data_t *)data
+                          scale:(float)scale
+                           gray:(BOOL)gray {
+    CGImageRef result = NULL;
+
+#if MS_SDK_REQUIREMENTS
+    CVImageBufferRef imageBuffer = CMSampleBufferGetImageBuffer(buf);
+
+    if (CVPixelBufferGetPixelFormatType(imageBuffer) != kCVPixelFormatType_32BGRA)
+        return NULL;
+
+    CVPixelBufferLockBaseAddress(imageBuffer, 0);
+
+    ms_color_img_t src;
+    src.data = CVPixelBufferGetBaseAddress(imageBuffer);
+    src.width = (int) CVPixelBufferGetWidth(imageBuffer);
+    src.height = (int) CVPixelBufferGetHeight(imageBuffer);
+    src.stride = (int) CVPixelBufferGetBytesPerRow(imageBuffer);
+
+    ms_color_img_t dst;
+    if (scale < 0)
+        dst = ms_color_img_warp(&src, data);
+    else
+        dst = ms_color_img_warp2(&src, data, scale);
+
+    CVPixelBufferUnlockBaseAddress(imageBuffer, 0);
+
+    result = gray ? MSCreateGrayCGImageFromColorImage(&dst) : MSCreateCGImageFromColorImage(&dst);
+#endif
+
+    return result;
+}
 #endif
 
 + (CGImageRef)newWarpFromImage:(CGImageRef)img data:(ms_warp_data_t *)data {
@@ -120,6 +271,10 @@ ms_img_t *MSCreateImageFromSampleBuffer2(CMSampleBufferRef sbuf, AVCaptureVideoO
 }
 
 + (CGImageRef)newWarpFromImage:(CGImageRef)img data:(ms_warp_data_t *)data scale:(float)scale {
+    return [self newWarpFromImage:img data:data scale:scale gray:NO];
+}
+
++ (CGImageRef)newWarpFromImage:(CGImageRef)img data:(ms_warp_data_t *)data scale:(float)scale gray:(BOOL)gray {
     CGImageRef result = NULL;
     
 #if MS_SDK_REQUIREMENTS
@@ -128,13 +283,34 @@ ms_img_t *MSCreateImageFromSampleBuffer2(CMSampleBufferRef sbuf, AVCaptureVideoO
     src.width = (int) CGImageGetWidth(img);
     src.height = (int) CGImageGetHeight(img);
     src.stride = (int) CGImageGetBytesPerRow(img);
-    src.data = malloc(src.stride * src.height);
-    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
-    CGContextRef context = CGBitmapContextCreate(src.data, src.width, src.height,
-                                                 8, src.stride, colorSpace,
-                                                 kCGBitmapByteOrder32Little | kCGImageAlphaPremultipliedFirst);
-    CGContextDrawImage(context, CGRectMake(0, 0, src.width, src.height), img);
-    CGContextRelease(context);
+    src.data = NULL;
+
+    // Camera frames (see `newCGImageFromBuffer:`) are already laid out as expected
+    // by the warp: take a plain copy of their bytes instead of redrawing them. The
+    // copy cannot be avoided with public APIs, use `newWarpFromBuffer:data:scale:gray:`
+    // to warp a camera frame in place.
+    CFDataRef bytes = NULL;
+    CGBitmapInfo info = CGImageGetBitmapInfo(img);
+    CGImageAlphaInfo alpha = info & kCGBitmapAlphaInfoMask;
+    if (CGImageGetBitsPerPixel(img) == 32 && CGImageGetBitsPerComponent(img) == 8 &&
+        (info & kCGBitmapByteOrderMask) == kCGBitmapByteOrder32Little &&
+        (alpha == kCGImageAlphaPremultipliedFirst || alpha == kCGImageAlphaNoneSkipFirst)) {
+        bytes = CGDataProviderCopyData(CGImageGetDataProvider(img));
+        if (bytes)
+            src.data = (unsigned char *) CFDataGetBytePtr(bytes);
+    }
+
+    if (!src.data) {
+        src.stride = 4 * src.width;
+        src.data = MSMalloc(src.stride * src.height);
+        CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+        CGContextRef context = CGBitmapContextCreate(src.data, src.width, src.height,
+                                                     8, src.stride, colorSpace,
+                                                     kCGBitmapByteOrder32Little | kCGImageAlphaPremultipliedFirst);
+        CGContextDrawImage(context, CGRectMake(0, 0, src.width, src.height), img);
+        CGContextRelease(context);
+        CGColorSpaceRelease(colorSpace);
+    }
     
     // Warp
     ms_color_img_t dst;
@@ -143,29 +319,94 @@ ms_img_t *MSCreateImageFromSampleBuffer2(CMSampleBufferRef sbuf, AVCaptureVideoO
     else
         dst = ms_color_img_warp2(&src, data, scale);
     
-    // Write to CGImage
-    if (dst.data) {
-        context = CGBitmapContextCreate(dst.data, dst.width, dst.height,
-                                        8, dst.stride, colorSpace,
-                                        kCGBitmapByteOrder32Little | kCGImageAlphaPremultipliedFirst);
-        result = CGBitmapContextCreateImage(context);
-        CGContextRelease(context);
-        free(dst.data);
-    }
-    CGColorSpaceRelease(colorSpace);
-    free(src.data);
+    // Write to CGImage, handing the warped pixels over without copying them
+    result = gray ? MSCreateGrayCGImageFromColorImage(&dst) : MSCreateCGImageFromColorImage(&dst);
+
+    if (bytes)
+        CFRelease(bytes);
+    else
+        MSFree(src.data);
 #endif
     
     return result;
 }
 @end
 
+static void ms_image_release_data(void *info, const void *data, size_t size) {
+    free((void *) data);
+}
+
+CGImageRef MSCreateCGImageFromColorImage(ms_color_img_t *img) {
+    if (!img->data)
+        return NULL;
+
+    CGDataProviderRef provider = CGDataProviderCreateWithData(NULL, img->data,
+                                                              img->stride * img->height,
+                                                              ms_image_release_data);
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGImageRef result = CGImageCreate(img->width, img->height, 8, 32, img->stride, colorSpace,
+                                      kCGBitmapByteOrder32Little | kCGImageAlphaPremultipliedFirst,
+                                      provider, NULL, false, kCGRenderingIntentDefault);
+    CGColorSpaceRelease(colorSpace);
+    CGDataProviderRelease(provider);
+    return result;
+}
+
+CGImageRef MSCreateGrayCGImageFromColorImage(ms_color_img_t *img) {
+    if (!img->data)
+        return NULL;
+
+    // Gray rows are never ahead of color rows, so convert in place
+    unsigned char *gray = img->data;
+    for (int y = 0; y < img->height; y++) {
+        const unsigned char *p = img->data + y * img->stride;
+        unsigned char *q = gray + y * img->width;
+        for (int x = 0; x < img->width; x++, p += 4)
+            q[x] = (unsigned char) ((29 * p[0] + 150 * p[1] + 77 * p[2]) >> 8);
+    }
+
+    CGDataProviderRef provider = CGDataProviderCreateWithData(NULL, gray,
+                                                              img->width * img->height,
+                                                              ms_image_release_data);
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceGray();
+    CGImageRef result = CGImageCreate(img->width, img->height, 8, 8, img->width, colorSpace,
+                                      kCGImageAlphaNone, provider, NULL, false,
+                                      kCGRenderingIntentDefault);
+    CGColorSpaceRelease(colorSpace);
+    CGDataProviderRelease(provider);
+    return result;
+}
+
 #if MS_IPHONE_OS_REQUIREMENTS
+ms_ori_t MSOrientationFromVideoOrientation(AVCaptureVideoOrientation orientation) {
+    switch (orientation) {
+        case AVCaptureVideoOrientationPortrait:
+            return MS_LEFT_BOTTOM_ORI;
+            
+        case AVCaptureVideoOrientationLandscapeRight:
+            return MS_TOP_LEFT_ORI;
+            
+        case AVCaptureVideoOrientationLandscapeLeft:
+            return MS_BOTTOM_RIGHT_ORI;
+            
+        case AVCaptureVideoOrientationPortraitUpsideDown:
+            return MS_RIGHT_TOP_ORI;
+            
+        default:
+            return MS_UNDEFINED_ORI;
+    }
+}
+
 ms_img_t *MSCreateImageFromSampleBuffer(CMSampleBufferRef sbuf) {
     return MSCreateImageFromSampleBuffer2(sbuf, -1);
 }
 
 ms_img_t *MSCreateImageFromSampleBuffer2(CMSampleBufferRef sbuf, AVCaptureVideoOrientation orientation) {
+    return MSCreateImageFromSampleBuffer3(sbuf, orientation, CGRectNull, NULL);
+}
+
+ms_img_t *MSCreateImageFromSampleBuffer3(CMSampleBufferRef sbuf, AVCaptureVideoOrientation orientation,
+                                         CGRect crop, CGRect *region) {
 #if MS_SDK_REQUIREMENTS
     CVImageBufferRef imageBuffer = CMSampleBufferGetImageBuffer(sbuf);
     
@@ -174,33 +415,33 @@ ms_img_t *MSCreateImageFromSampleBuffer2(CMSampleBufferRef sbuf, AVCaptureVideoO
     
     CVPixelBufferLockBaseAddress(imageBuffer, 0); 
     
-    void *data = CVPixelBufferGetBaseAddress(imageBuffer); 
+    unsigned char *data = CVPixelBufferGetBaseAddress(imageBuffer);
     int bpr = (int) CVPixelBufferGetBytesPerRow(imageBuffer);
     int width = (int) CVPixelBufferGetWidth(imageBuffer);
     int height = (int) CVPixelBufferGetHeight(imageBuffer);
+    int frameWidth = width;
+    int frameHeight = height;
+
+    if (!CGRectIsNull(crop)) {
+        CGRect r = CGRectIntegral(CGRectIntersection(crop, CGRectMake(0, 0, width, height)));
+        if (CGRectIsEmpty(r)) {
+            CVPixelBufferUnlockBaseAddress(imageBuffer, 0);
+            return NULL;
+        }
+        // Keep rows 16-byte aligned
+        int x = ((int) r.origin.x) & ~3;
+        int y = (int) r.origin.y;
+        width = (int) (r.origin.x + r.size.width) - x;
+        height = (int) r.size.height;
+        data += y * bpr + 4 * x;
+        if (region) {
+            *region = CGRectMake(2.0f * x / frameWidth - 1, 2.0f * y / frameHeight - 1,
+                                 2.0f * width / frameWidth, 2.0f * height / frameHeight);
+        }
+    }
     
     ms_pix_fmt_t fmt = MS_PIX_FMT_RGB32;
-    ms_ori_t ori = MS_UNDEFINED_ORI;
-    switch (orientation) {
-        case AVCaptureVideoOrientationPortrait:
-            ori = MS_LEFT_BOTTOM_ORI;
-            break;
-            
-        case AVCaptureVideoOrientationLandscapeRight:
-            ori = MS_TOP_LEFT_ORI;
-            break;
-            
-        case AVCaptureVideoOrientationLandscapeLeft:
-            ori = MS_BOTTOM_RIGHT_ORI;
-            break;
-            
-        case AVCaptureVideoOrientationPortraitUpsideDown:
-            ori = MS_RIGHT_TOP_ORI;
-            break;
-            
-        default:
-            break;
-    }
+    ms_ori_t ori = MSOrientationFromVideoOrientation(orientation);
     
     ms_img_t *img;
     ms_errcode ecode = ms_img_new(data, width, height, bpr, fmt, ori, &img);
@@ -212,4 +453,73 @@ ms_img_t *MSCreateImageFromSampleBuffer2(CMSampleBufferRef sbuf, AVCaptureVideoO
     return NULL;
 #endif
 }
+
+ms_img_t *MSCreateHalfSizeImageFromSampleBuffer(CMSampleBufferRef sbuf, AVCaptureVideoOrientation orientation) {
+    return MSCreateHalfSizeImageFromSampleBufferInArena(sbuf, orientation, NULL);
+}
+
+ms_img_t *MSCreateHalfSizeImageFromSampleBufferInArena(CMSampleBufferRef sbuf, AVCaptureVideoOrientation orientation,
+                                                      MSArena *arena) {
+#if MS_SDK_REQUIREMENTS
+    CVImageBufferRef imageBuffer = CMSampleBufferGetImageBuffer(sbuf);
+    
+    if (CVPixelBufferGetPixelFormatType(imageBuffer) != kCVPixelFormatType_32BGRA)
+        return NULL;
+    
+    int width = (int) CVPixelBufferGetWidth(imageBuffer);
+    int height = (int) CVPixelBufferGetHeight(imageBuffer);
+    if (MAX(width, height) / 2 < 480)
+        return MSCreateImageFromSampleBuffer2(sbuf, orientation);
+    
+    CVPixelBufferLockBaseAddress(imageBuffer, 0);
+    
+    ms_img_t *img = MSCreateHalfSizeImage(CVPixelBufferGetBaseAddress(imageBuffer), width, height,
+                                          (int) CVPixelBufferGetBytesPerRow(imageBuffer),
+                                          MSOrientationFromVideoOrientation(orientation), arena);
+    
+    CVPixelBufferUnlockBaseAddress(imageBuffer, 0);
+    
+    return img;
+#else
+    return NULL;
+#endif
+}
 #endif
+
+ms_img_t *MSCreateHalfSizeImage(const unsigned char *data, int width, int height, int bpr,
+                                ms_ori_t orientation, MSArena *arena) {
+#if MS_SDK_REQUIREMENTS
+    width /= 2;
+    height /= 2;
+    if (MAX(width, height) < 480)
+        return NULL;
+    
+    unsigned char *heap = NULL;
+    unsigned char *gray = arena ? MSArenaAlloc(arena, width * height) : NULL;
+    if (!gray)
+        gray = heap = MSMalloc(width * height);
+    if (!gray)
+        return NULL;
+    
+    // Average each 2x2 block, then convert it to gray
+    for (int y = 0; y < height; y++) {
+        const unsigned char *p0 = data + 2 * y * bpr;
+        const unsigned char *p1 = p0 + bpr;
+        unsigned char *q = gray + y * width;
+        for (int x = 0; x < width; x++, p0 += 8, p1 += 8) {
+            int b = p0[0] + p0[4] + p1[0] + p1[4];
+            int g = p0[1] + p0[5] + p1[1] + p1[5];
+            int r = p0[2] + p0[6] + p1[2] + p1[6];
+            q[x] = (unsigned char) ((29 * b + 150 * g + 77 * r) >> 10);
+        }
+    }
+    
+    ms_img_t *img;
+    ms_errcode ecode = ms_img_new(gray, width, height, width, MS_PIX_FMT_GRAY8, orientation, &img);
+    MSFree(heap);
+    
+    return (ecode == MS_SUCCESS) ? img : NULL;
+#else
+    return NULL;
+#endif
+}
@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+
+#include <stdint.h>
+
+/** Persistent LRU cache of the IDs recognized by Moodstocks API.
+ *
+ * Each entry associates a compact global descriptor of a snapped frame (see
+ * `MSQualityHash`) to the ID of the image it has been recognized as on Moodstocks
+ * API. When the same item is snapped again, the scanner session looks the frame
+ * descriptor up in this cache and matches the frame on-device against the cached
+ * ID, which only succeeds once it has been synced to the local database. The
+ * descriptor only designates a candidate: different items snapped in a similar
+ * way may share it, hence the on-device check.
+ *
+ * The cache is stored in the caches directory: it survives the scanner being closed
+ * as well as application restarts. It is stored when the application goes to
+ * background or terminates, or with `save`.
+ */
+@interface MSOnlineCache : NSObject {
+    NSString *_path;
+    NSMutableArray *_entries;
+    NSUInteger _capacity;
+    NSUInteger _byteBudget;
+    NSUInteger _bytes;
+    int _maxDistance;
+    BOOL _dirty;
+}
+
+/** The maximum number of IDs held by the cache.
+ */
+@property (nonatomic, readonly) NSUInteger capacity;
+/** The maximum size of the cached entries, in bytes, counted as the size of each ID
+ * in UTF-8 plus that of its descriptor. The least recently used entries are evicted
+ * to meet it, but the most recent one is always kept. By default, this value is set
+ * to 16 KB.
+ */
+@property (nonatomic, assign) NSUInteger byteBudget;
+/** The maximum number of differing bits for two descriptors to be considered as
+ * near-duplicates. By default, this value is set to 10.
+ */
+@property (nonatomic, assign) int maxDistance;
+
+///---------------------------------------------------------------------------------------
+/// @name Initialization Methods
+///---------------------------------------------------------------------------------------
+
+/** Initialize a cache that holds up to 256 IDs, stored under a default filename.
+ *
+ * @return the cache instance.
+ */
+- (id)init;
+
+/** Initialize a cache, loading the IDs previously stored under the given filename.
+ *
+ * @param filename the filename to use, without extension.
+ * @param capacity the maximum number of IDs held by the cache.
+ * @return the cache instance.
+ */
+- (id)initWithFilename:(NSString *)filename capacity:(NSUInteger)capacity;
+
+///---------------------------------------------------------------------------------------
+/// @name Cache Methods
+///---------------------------------------------------------------------------------------
+
+/** Find the cached ID whose descriptor is the closest to the input one.
+ *
+ * @param hash the query frame descriptor.
+ * @return the cached ID, or `nil` if there is no near-duplicate entry.
+ */
+- (NSString *)IDForHash:(uint64_t)hash;
+
+/** Add an ID to the cache, evicting the least recently used ones if needed.
+ *
+ * @param ID the image ID returned by Moodstocks API.
+ * @param hash the descriptor of the frame that led to this ID.
+ */
+- (void)addID:(NSString *)ID forHash:(uint64_t)hash;
+
+/** Remove all the cached IDs, and the stored cache.
+ */
+- (void)removeAllIDs;
+
+/** Store the cache if it has been modified since it has been loaded or last stored.
+ */
+- (void)save;
+
+@end
@@ -0,0 +1,205 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "MSOnlineCache.h"
+#import "MSAvailability.h"
+#import "MSQuality.h"
+#import "MSObjC.h"
+
+#if MS_IPHONE_OS_REQUIREMENTS
+  #import <UIKit/UIKit.h>
+#endif
+
+static NSString *kMSOnlineCacheFilename = @"ms_online";
+static const NSUInteger kMSOnlineCacheCapacity = 256;
+static const NSUInteger kMSOnlineCacheByteBudget = 16 * 1024;
+static const int kMSOnlineCacheMaxDistance = 10;
+
+static NSString *kMSOnlineCacheHashKey = @"hash";
+static NSString *kMSOnlineCacheIDKey = @"id";
+
+@interface MSOnlineCache ()
+- (void)evict;
+#if MS_IPHONE_OS_REQUIREMENTS
+- (void)applicationDidEnterBackground:(void *)ignored;
+#endif
+@end
+
+static NSUInteger ms_online_entry_size(NSDictionary *entry) {
+    NSString *ID = [entry objectForKey:kMSOnlineCacheIDKey];
+    return [ID lengthOfBytesUsingEncoding:NSUTF8StringEncoding] + sizeof(uint64_t);
+}
+
+@implementation MSOnlineCache
+
+@synthesize capacity = _capacity;
+@synthesize byteBudget = _byteBudget;
+@synthesize maxDistance = _maxDistance;
+
+- (id)init {
+    return [self initWithFilename:kMSOnlineCacheFilename capacity:kMSOnlineCacheCapacity];
+}
+
+- (id)initWithFilename:(NSString *)filename capacity:(NSUInteger)capacity {
+    self = [super init];
+    if (self) {
+        NSArray *paths = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
+        NSString *completeFilename = [NSString stringWithFormat:@"%@.plist", filename];
+        _path = [[[paths objectAtIndex:0] stringByAppendingPathComponent:completeFilename] retain_stub];
+        _capacity = (capacity > 0) ? capacity : 1;
+        _maxDistance = kMSOnlineCacheMaxDistance;
+        _byteBudget = kMSOnlineCacheByteBudget;
+        _bytes = 0;
+        _entries = [[NSMutableArray alloc] initWithCapacity:_capacity];
+        _dirty = NO;
+
+        for (id entry in [NSArray arrayWithContentsOfFile:_path]) {
+            if (![entry isKindOfClass:[NSDictionary class]]) continue;
+            if (![[entry objectForKey:kMSOnlineCacheHashKey] isKindOfClass:[NSNumber class]]) continue;
+            if (![[entry objectForKey:kMSOnlineCacheIDKey] isKindOfClass:[NSString class]]) continue;
+            [_entries addObject:entry];
+            _bytes += ms_online_entry_size(entry);
+        }
+        [self evict];
+
+#if MS_IPHONE_OS_REQUIREMENTS
+        // Writes are batched until the application leaves the foreground
+        NSNotificationCenter *center = [NSNotificationCenter defaultCenter];
+        [center addObserver:self
+                   selector:@selector(applicationDidEnterBackground:)
+                       name:UIApplicationDidEnterBackgroundNotification
+                     object:nil];
+        [center addObserver:self
+                   selector:@selector(applicationDidEnterBackground:)
+                       name:UIApplicationWillTerminateNotification
+                     object:nil];
+#endif
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [self save];
+
+    [_path release_stub];
+    _path = nil;
+    [_entries release_stub];
+    _entries = nil;
+
+#if ! __has_feature(objc_arc)
+    [super dealloc];
+#endif
+}
+
+- (NSString *)IDForHash:(uint64_t)hash {
+    NSString *ID = nil;
+    @synchronized(self) {
+        NSDictionary *best = nil;
+        int bestDistance = _maxDistance + 1;
+        for (NSDictionary *entry in _entries) {
+            // Stored as signed since property lists lack unsigned 64-bit integers
+            uint64_t h = (uint64_t) [[entry objectForKey:kMSOnlineCacheHashKey] longLongValue];
+            int d = MSQualityHashDistance(hash, h);
+            if (d < bestDistance) {
+                best = entry;
+                bestDistance = d;
+            }
+        }
+        if (best != nil) {
+            // Most recently used entries come first
+            [best retain_stub];
+            [_entries removeObjectIdenticalTo:best];
+            [_entries insertObject:best atIndex:0];
+            [best release_stub];
+            _dirty = YES;
+            ID = [[[best objectForKey:kMSOnlineCacheIDKey] retain_stub] autorelease_stub];
+        }
+    }
+    return ID;
+}
+
+- (void)setByteBudget:(NSUInteger)byteBudget {
+    @synchronized(self) {
+        _byteBudget = byteBudget;
+        [self evict];
+    }
+}
+
+- (void)addID:(NSString *)ID forHash:(uint64_t)hash {
+    if (ID == nil) return;
+    @synchronized(self) {
+        for (NSInteger i = [_entries count] - 1; i >= 0; i--) {
+            NSDictionary *entry = [_entries objectAtIndex:i];
+            if ([[entry objectForKey:kMSOnlineCacheIDKey] isEqualToString:ID]) {
+                _bytes -= ms_online_entry_size(entry);
+                [_entries removeObjectAtIndex:i];
+            }
+        }
+
+        NSDictionary *entry = [NSDictionary dictionaryWithObjectsAndKeys:
+                               [NSNumber numberWithLongLong:(long long) hash], kMSOnlineCacheHashKey,
+                               ID, kMSOnlineCacheIDKey, nil];
+        [_entries insertObject:entry atIndex:0];
+        _bytes += ms_online_entry_size(entry);
+
+        [self evict];
+        _dirty = YES;
+    }
+}
+
+- (void)removeAllIDs {
+    @synchronized(self) {
+        [_entries removeAllObjects];
+        _bytes = 0;
+        [[NSFileManager defaultManager] removeItemAtPath:_path error:nil];
+        _dirty = NO;
+    }
+}
+
+- (void)save {
+    @synchronized(self) {
+        if (_dirty) {
+            [_entries writeToFile:_path atomically:YES];
+            _dirty = NO;
+        }
+    }
+}
+
+#pragma mark - Private
+
+- (void)evict {
+    while ([_entries count] > 1 && ([_entries count] > _capacity || _bytes > _byteBudget)) {
+        _bytes -= ms_online_entry_size([_entries lastObject]);
+        [_entries removeLastObject];
+        _dirty = YES;
+    }
+}
+
+#if MS_IPHONE_OS_REQUIREMENTS
+- (void)applicationDidEnterBackground:(void *)ignored {
+    [self save];
+}
+#endif
+
+@end
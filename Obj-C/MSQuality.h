@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+
+#include "moodstocks_sdk.h"
+
+/** Dimensions of the luminance thumbnail used to compare consecutive frames.
+ */
+#define MS_QUALITY_THUMB_W 32
+#define MS_QUALITY_THUMB_H 18
+
+/** Downsampled luminance of a frame, used as reference to score frame changes.
+ */
+typedef struct {
+    unsigned char pix[MS_QUALITY_THUMB_W * MS_QUALITY_THUMB_H];
+    int valid;
+} MSQualityThumb;
+
+/** Compute cheap quality scores over raw frame data.
+ *
+ * The sharpness is the mean gradient energy measured at full resolution over a
+ * sparse grid of sample points: it drops sharply on motion-blurred or out of focus
+ * frames. The motion is the mean absolute difference between the luminance thumbnail
+ * of this frame and the `prev` one: it stays close to 0 when the camera is static.
+ *
+ * Both scores are in the [0..255] range and are computed in a few tens of
+ * microseconds on a 1280x720 frame.
+ *
+ * @param data the pointer to the frame data (the luminance plane for NV21).
+ * @param w the frame width in pixels.
+ * @param h the frame height in pixels.
+ * @param bpr the size of a frame row in bytes (of the luminance plane for NV21).
+ * @param fmt the frame pixel format.
+ * @param prev the thumbnail of the frame to compare with, or `NULL`.
+ * @param sharpness the pointer to the variable into which the sharpness is assigned.
+ * @param motion the pointer to the variable into which the motion is assigned. It is
+ * set to -1 if there is no valid `prev` thumbnail to compare with.
+ * @param thumb the thumbnail to fill with the current frame, or `NULL`.
+ * @return 0 if the scores could be computed, 1 otherwise.
+ */
+int MSImageQuality(const void *data,
+                   int w,
+                   int h,
+                   int bpr,
+                   ms_pix_fmt_t fmt,
+                   const MSQualityThumb *prev,
+                   float *sharpness,
+                   float *motion,
+                   MSQualityThumb *thumb);
+
+/** Compute a compact global descriptor of a frame from its thumbnail.
+ *
+ * This is a 64-bit difference hash: near-duplicate views of the same scene give
+ * hashes that only differ by a few bits (see `MSQualityHashDistance`).
+ *
+ * @param thumb a valid thumbnail, as filled by `MSImageQuality`.
+ * @return the hash.
+ */
+uint64_t MSQualityHash(const MSQualityThumb *thumb);
+
+/** Get the number of differing bits between two hashes.
+ *
+ * @param a the first hash.
+ * @param b the second hash.
+ * @return the Hamming distance between `a` and `b`, in the [0..64] range.
+ */
+int MSQualityHashDistance(uint64_t a, uint64_t b);
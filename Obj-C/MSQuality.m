@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "MSQuality.h"
+
+#include <stdlib.h>
+
+/** Number of sample points used to measure the gradient energy.
+ */
+#define MS_QUALITY_GRID_W 64
+#define MS_QUALITY_GRID_H 36
+
+static inline int ms_quality_luma(const unsigned char *row, int x, ms_pix_fmt_t fmt) {
+    if (fmt == MS_PIX_FMT_RGB32) {
+        // BGRA on little-endian CPU arch
+        const unsigned char *p = row + 4 * x;
+        return (p[0] + 2 * p[1] + p[2]) >> 2;
+    }
+    return row[x];
+}
+
+int MSImageQuality(const void *data,
+                   int w,
+                   int h,
+                   int bpr,
+                   ms_pix_fmt_t fmt,
+                   const MSQualityThumb *prev,
+                   float *sharpness,
+                   float *motion,
+                   MSQualityThumb *thumb) {
+    if (data == NULL || fmt < 0 || fmt >= MS_PIX_FMT_NB)
+        return 1;
+    if (w < 2 * MS_QUALITY_GRID_W || h < 2 * MS_QUALITY_GRID_H)
+        return 1;
+
+    const unsigned char *pix = (const unsigned char *) data;
+
+    // Gradient energy, at full resolution, on a sparse grid
+    if (sharpness) {
+        unsigned int energy = 0;
+        for (int j = 0; j < MS_QUALITY_GRID_H; j++) {
+            int y = ((2 * j + 1) * (h - 1)) / (2 * MS_QUALITY_GRID_H);
+            const unsigned char *row = pix + y * bpr;
+            const unsigned char *next = row + bpr;
+            for (int i = 0; i < MS_QUALITY_GRID_W; i++) {
+                int x = ((2 * i + 1) * (w - 1)) / (2 * MS_QUALITY_GRID_W);
+                int c = ms_quality_luma(row, x, fmt);
+                energy += abs(ms_quality_luma(row, x + 1, fmt) - c);
+                energy += abs(ms_quality_luma(next, x, fmt) - c);
+            }
+        }
+        *sharpness = (float) energy / (2 * MS_QUALITY_GRID_W * MS_QUALITY_GRID_H);
+    }
+
+    // Luminance thumbnail, each cell is the 2x2 average around its center
+    MSQualityThumb cur;
+    for (int j = 0; j < MS_QUALITY_THUMB_H; j++) {
+        int y = ((2 * j + 1) * (h - 1)) / (2 * MS_QUALITY_THUMB_H);
+        const unsigned char *row = pix + y * bpr;
+        const unsigned char *next = row + bpr;
+        for (int i = 0; i < MS_QUALITY_THUMB_W; i++) {
+            int x = ((2 * i + 1) * (w - 1)) / (2 * MS_QUALITY_THUMB_W);
+            int sum = ms_quality_luma(row, x, fmt) + ms_quality_luma(row, x + 1, fmt) +
+                      ms_quality_luma(next, x, fmt) + ms_quality_luma(next, x + 1, fmt);
+            cur.pix[j * MS_QUALITY_THUMB_W + i] = (unsigned char) (sum >> 2);
+        }
+    }
+    cur.valid = 1;
+
+    // Frame difference
+    if (motion) {
+        if (prev != NULL && prev->valid) {
+            unsigned int diff = 0;
+            for (int k = 0; k < MS_QUALITY_THUMB_W * MS_QUALITY_THUMB_H; k++)
+                diff += abs(cur.pix[k] - prev->pix[k]);
+            *motion = (float) diff / (MS_QUALITY_THUMB_W * MS_QUALITY_THUMB_H);
+        }
+        else {
+            *motion = -1;
+        }
+    }
+
+    if (thumb)
+        *thumb = cur;
+
+    return 0;
+}
+
+uint64_t MSQualityHash(const MSQualityThumb *thumb) {
+    // Average the thumbnail down to 9x8 cells then compare horizontal neighbours
+    int cells[8][9];
+    for (int j = 0; j < 8; j++) {
+        int y0 = (j * MS_QUALITY_THUMB_H) / 8, y1 = ((j + 1) * MS_QUALITY_THUMB_H) / 8;
+        for (int i = 0; i < 9; i++) {
+            int x0 = (i * MS_QUALITY_THUMB_W) / 9, x1 = ((i + 1) * MS_QUALITY_THUMB_W) / 9;
+            int sum = 0;
+            for (int y = y0; y < y1; y++)
+                for (int x = x0; x < x1; x++)
+                    sum += thumb->pix[y * MS_QUALITY_THUMB_W + x];
+            cells[j][i] = sum / ((y1 - y0) * (x1 - x0));
+        }
+    }
+
+    uint64_t hash = 0;
+    for (int j = 0; j < 8; j++)
+        for (int i = 0; i < 8; i++)
+            hash = (hash << 1) | (cells[j][i] < cells[j][i + 1] ? 1 : 0);
+    return hash;
+}
+
+int MSQualityHashDistance(uint64_t a, uint64_t b) {
+    uint64_t x = a ^ b;
+    int n = 0;
+    while (x) {
+        x &= x - 1;
+        n++;
+    }
+    return n;
+}
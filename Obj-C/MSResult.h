@@ -35,8 +35,10 @@ typedef ms_result_type MSResultType;
 /** Extra information to attach to the results of a scan.
  */
 typedef enum {
-    MS_RESULT_EXTRA_NONE = 0,
-    MS_RESULT_EXTRA_IMAGE
+    MS_RESULT_EXTRA_NONE   = 0,
+    MS_RESULT_EXTRA_IMAGE  = 1 << 0,
+    /* Warp new image results straight from the camera frame (see `getWarped:`) */
+    MS_RESULT_EXTRA_WARPED = 1 << 1
 } MSResultExtra;
 
 /** Result of a scan.
@@ -65,8 +67,12 @@ typedef enum {
  */
 @interface MSResult : NSObject <NSCopying> {
     ms_result_t *_result;
+    id _owner;
+    NSUInteger _hash;
+    CGRect _region;
 #if MS_IPHONE_OS_REQUIREMENTS
     CGImageRef _image;
+    CGImageRef _warped;
     AVCaptureVideoOrientation _orientation;
 #endif
 }
@@ -92,6 +98,16 @@ typedef enum {
  */
 - (id)initWithResult:(const ms_result_t *)result;
 
+/** Initialize a result by taking ownership of result.
+ *
+ * This avoids duplicating the result: the caller must *not* delete it afterwards, it is
+ * deleted once this result and all its copies are released.
+ *
+ * @param result the result to be initialized with.
+ * @return a result instance.
+ */
+- (id)initWithResultNoCopy:(ms_result_t *)result;
+
 ///---------------------------------------------------------------------------------------
 /// @name Getter Methods
 ///---------------------------------------------------------------------------------------
@@ -186,6 +202,18 @@ typedef enum {
  */
 - (BOOL)getDimensions:(CGSize *)dims;
 
+/** Set the region of the camera frame covered by the query image that led to this result.
+ *
+ * This is needed when the query image has been created from a crop of the camera
+ * frame (see `MSImage`) so that `getCorners:` and `getHomography:` are expressed within
+ * the whole frame domain. You should not have to call this method directly, since the
+ * scanner does it behind the scenes.
+ *
+ * @param region the region of the frame in its initial orientation, with coordinates in
+ * the [-1..1] range.
+ */
+- (void)setRegion:(CGRect)region;
+
 #if MS_IPHONE_OS_REQUIREMENTS
 /** Sets the CGImage corresponding to the query frame associated with this result.
  * 
@@ -197,6 +225,17 @@ typedef enum {
  */
 - (void)setImage:(CGImageRef)img withOrientation:(AVCaptureVideoOrientation)ori;
 
+/** Sets the warped image of the recognized object, e.g. computed straight from the
+ * camera frame with `[MSImage newWarpFromBuffer:data:scale:gray:]`.
+ *
+ * You should not have to call this method directly, since the scanner session does it
+ * behind the scenes when the `MS_RESULT_EXTRA_WARPED` flag is set.
+ *
+ * @param img the warped image at the maximum possible resolution. The resulting
+ * `MSResult` object retains a reference on this image.
+ */
+- (void)setWarped:(CGImageRef)img;
+
 /**
  * Get the query image corresponding to this result, as physically provided by the camera,
  * i.e not re-oriented.
@@ -233,8 +272,14 @@ typedef enum {
  * Given the fact that this method tries to retrieve the best possible quality, it
  * can be quite time-consuming and should be run asynchronously.
  *
- * WARNING: This method will always return `NO` if the `MS_RESULT_EXTRA_IMAGE` flag
- * has not been added to the `MSScannerSession` using the `setExtras` method!
+ * If the `MS_RESULT_EXTRA_WARPED` flag has been added to the `MSScannerSession`, the
+ * warped image has already been computed straight from the camera frame, without any
+ * intermediate copy, and is returned right away. This is only done for the frame on
+ * which a result is first found, not for the following frames where it stays locked.
+ *
+ * WARNING: This method will always return `NO` if neither the `MS_RESULT_EXTRA_IMAGE`
+ * nor the `MS_RESULT_EXTRA_WARPED` flag has been added to the `MSScannerSession` using
+ * the `setExtras` method!
  * @param warped the pointer to the `UIImage` where to store the result.
  * @return `YES` if successful, `NO` otherwise.
  */
@@ -253,6 +298,17 @@ typedef enum {
  * @return `YES` if successful, `NO` otherwise.
  */
 - (BOOL)getWarped:(UIImage **)warped scale:(float)scale;
+
+/**
+ * Similar to the above method, with the option to get an 8-bit grayscale image,
+ * which is lighter to hand over to e.g. an OCR library.
+ * @param warped the pointer to the `UIImage` where to store the result.
+ * @param scale the scaling factor, in the [0..1] range, or a negative value to get
+ * the maximum possible resolution.
+ * @param gray `YES` to get a grayscale image, `NO` to get a color image.
+ * @return `YES` if successful, `NO` otherwise.
+ */
+- (BOOL)getWarped:(UIImage **)warped scale:(float)scale gray:(BOOL)gray;
 #endif
 
 ///---------------------------------------------------------------------------------------
@@ -267,6 +323,9 @@ typedef enum {
 - (BOOL)isEqualToResult:(MSResult *)result;
 
 /** Clone a result.
+ *
+ * Results are immutable so this is cheap: the clone shares the underlying result data
+ * and query frame with the original result.
  *
  * @param zone the zone object.
  * @return the clone result instance.
@@ -26,6 +26,55 @@
 #import "MSObjC.h"
 #import "MSImage.h"
 
+// Map coordinates in the [-1..1] range within `region` to the whole frame domain
+static void ms_result_map_corners(CGRect region, float c[8]) {
+    for (int i = 0; i < 4; ++i) {
+        c[2*i]   = region.origin.x + (c[2*i] + 1) * region.size.width / 2;
+        c[2*i+1] = region.origin.y + (c[2*i+1] + 1) * region.size.height / 2;
+    }
+}
+
+static void ms_result_map_homography(CGRect region, float h[9]) {
+    float sx = region.size.width / 2, tx = region.origin.x + sx;
+    float sy = region.size.height / 2, ty = region.origin.y + sy;
+    for (int j = 0; j < 3; ++j) {
+        h[j]   = sx * h[j] + tx * h[6+j];
+        h[3+j] = sy * h[3+j] + ty * h[6+j];
+    }
+}
+
+static BOOL ms_result_is_cropped(CGRect region) {
+    return !CGRectEqualToRect(region, CGRectMake(-1, -1, 2, 2));
+}
+
+/** Owner of an `ms_result_t`, shared by a result and all its copies.
+ */
+@interface MSResultHandle : NSObject {
+@public
+    ms_result_t *_handle;
+}
+@end
+
+@implementation MSResultHandle
+
+- (void)dealloc {
+#if MS_SDK_REQUIREMENTS
+    if (_handle)
+        ms_result_del(_handle);
+#endif
+    _handle = NULL;
+
+#if ! __has_feature(objc_arc)
+    [super dealloc];
+#endif
+}
+
+@end
+
+@interface MSResult ()
+- (id)initWithOwner:(MSResultHandle *)owner hash:(NSUInteger)hash;
+@end
+
 @implementation MSResult
 
 @synthesize handle = _result;
@@ -34,8 +83,10 @@
     self = [super init];
     if (self) {
         _result = NULL;
+        _region = CGRectMake(-1, -1, 2, 2);
 #if MS_IPHONE_OS_REQUIREMENTS
         _image = NULL;
+        _warped = NULL;
         _orientation = AVCaptureVideoOrientationPortrait;
 #endif
     }
@@ -43,12 +94,41 @@
 }
 
 - (id)initWithResult:(const ms_result_t *)result {
+    ms_result_t *dup = NULL;
+#if MS_SDK_REQUIREMENTS
+    ms_result_dup(result, &dup);
+#endif
+    return [self initWithResultNoCopy:dup];
+}
+
+- (id)initWithResultNoCopy:(ms_result_t *)result {
     self = [self init];
+    if (self && result) {
+        MSResultHandle *owner = [[MSResultHandle alloc] init];
+        owner->_handle = result;
+        _owner = owner;
+        _result = result;
 #if MS_SDK_REQUIREMENTS
-    if (self) {
-        ms_result_dup(result, &_result);
-    }
+        // FNV-1a over the type and data, used to tell different results apart quickly
+        const char *bytes = NULL;
+        int length = 0;
+        ms_result_get_data(_result, &bytes, &length);
+        NSUInteger hash = 2166136261U ^ (NSUInteger) ms_result_get_type(_result);
+        for (int i = 0; i < length; i++)
+            hash = (hash ^ (unsigned char) bytes[i]) * 16777619U;
+        _hash = hash;
 #endif
+    }
+    return self;
+}
+
+- (id)initWithOwner:(MSResultHandle *)owner hash:(NSUInteger)hash {
+    self = [self init];
+    if (self && owner) {
+        _owner = [owner retain_stub];
+        _result = owner->_handle;
+        _hash = hash;
+    }
     return self;
 }
 
@@ -117,6 +197,8 @@
 #if MS_SDK_REQUIREMENTS
     if (_result) {
         if (!ms_result_get_homography(_result, homog)) {
+            if (ms_result_is_cropped(_region))
+                ms_result_map_homography(_region, homog);
             return YES;
         };
     }
@@ -129,6 +211,8 @@
     if (_result) {
         float c[8];
         if (!ms_result_get_corners(_result, c)) {
+            if (ms_result_is_cropped(_region))
+                ms_result_map_corners(_region, c);
             for (int i = 0; i < 4; ++i) {
                 corners[i] = CGPointMake(c[2*i], c[2*i+1]);
             }
@@ -144,6 +228,8 @@
     if (_result) {
         float c[8];
         if (!ms_result_get_corners(_result, c)) {
+            if (ms_result_is_cropped(_region))
+                ms_result_map_corners(_region, c);
             switch (ori) {
                 case UIInterfaceOrientationPortrait:
                     for (int i = 0; i < 4; ++i) {
@@ -190,13 +276,26 @@
     return NO;
 }
 
+- (void)setRegion:(CGRect)region {
+    _region = region;
+}
+
 #if MS_IPHONE_OS_REQUIREMENTS
 - (void)setImage:(CGImageRef)img withOrientation:(AVCaptureVideoOrientation)ori {
+    CGImageRetain(img);
+    if (_image)
+        CGImageRelease(_image);
     _image = img;
-    CGImageRetain(_image);
     _orientation = ori;
 }
 
+- (void)setWarped:(CGImageRef)img {
+    CGImageRetain(img);
+    if (_warped)
+        CGImageRelease(_warped);
+    _warped = img;
+}
+
 - (BOOL)getImage:(UIImage **)img {
     if (!_image)
         return NO;
@@ -226,10 +325,18 @@
 }
 
 - (BOOL)getWarped:(UIImage **)warped {
+    if (_warped) {
+        *warped = [UIImage imageWithCGImage:_warped];
+        return YES;
+    }
     return [self getWarped:warped scale:-1];
 }
 
 - (BOOL)getWarped:(UIImage **)warped scale:(float)scale {
+    return [self getWarped:warped scale:scale gray:NO];
+}
+
+- (BOOL)getWarped:(UIImage **)warped scale:(float)scale gray:(BOOL)gray {
 #if MS_SDK_REQUIREMENTS
     if (!_image)
         return NO;
@@ -240,7 +347,7 @@
     ms_warp_data_t data = { .homography = homog,
                             .width = s.width,
                             .height = s.height };
-    CGImageRef warp = [MSImage newWarpFromImage:_image data:&data scale:scale];
+    CGImageRef warp = [MSImage newWarpFromImage:_image data:&data scale:scale gray:gray];
     *warped = [UIImage imageWithCGImage:warp];
     CGImageRelease(warp);
     return YES;
@@ -253,6 +360,12 @@
 
 - (BOOL)isEqualToResult:(MSResult *)result {
 #if MS_SDK_REQUIREMENTS
+    if (result == nil || _result == NULL || [result handle] == NULL)
+        return NO;
+    if (_result == [result handle])
+        return YES;
+    if (_hash != result->_hash)
+        return NO;
     return ms_result_cmp(_result, [result handle]) == 0 ? YES : NO;
 #else
     return NO;
@@ -260,15 +373,16 @@
 }
 
 - (void)dealloc {
-#if MS_SDK_REQUIREMENTS
-    if (_result)
-        ms_result_del(_result);
-#endif
+    [_owner release_stub];
+    _owner = nil;
     _result = NULL;
 #if MS_IPHONE_OS_REQUIREMENTS
     if (_image)
         CGImageRelease(_image);
     _image = NULL;
+    if (_warped)
+        CGImageRelease(_warped);
+    _warped = NULL;
 #endif
 
 #if ! __has_feature(objc_arc)
@@ -278,9 +392,12 @@
 
 - (id)copyWithZone:(NSZone *)zone {
 #if MS_SDK_REQUIREMENTS
-    MSResult *copy = [[MSResult allocWithZone:zone] initWithResult:_result];
+    MSResult *copy = [[MSResult allocWithZone:zone] initWithOwner:_owner hash:_hash];
+    [copy setRegion:_region];
     if (_image)
-        [copy setImage:CGImageCreateCopy(_image) withOrientation:_orientation];
+        [copy setImage:_image withOrientation:_orientation];
+    if (_warped)
+        [copy setWarped:_warped];
     return copy;
 #else
     return nil;
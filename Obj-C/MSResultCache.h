@@ -0,0 +1,137 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+
+#include <stdint.h>
+
+#import "MSResult.h"
+
+/** Small in-memory LRU cache of recently recognized image results.
+ *
+ * Each entry associates a compact global descriptor of the query frame (see
+ * `MSQualityHash`) to the result it led to. When the user re-aims at an item that
+ * has just been recognized, the scanner session looks the query descriptor up in
+ * this cache and matches the frame against the cached reference only, instead of
+ * performing a full search over the local database.
+ *
+ * The cache also keeps hit-rate and latency counters.
+ */
+@interface MSResultCache : NSObject {
+    NSMutableArray *_entries;
+    NSUInteger _capacity;
+    int _maxDistance;
+    NSUInteger _lookups;
+    NSUInteger _hits;
+    NSTimeInterval _hitTime;
+    NSUInteger _misses;
+    NSTimeInterval _missTime;
+}
+
+/** The maximum number of results held by the cache.
+ */
+@property (nonatomic, readonly) NSUInteger capacity;
+/** The maximum number of differing bits for two descriptors to be considered as
+ * near-duplicates. By default, this value is set to 10.
+ */
+@property (nonatomic, assign) int maxDistance;
+/** The number of lookups, whether they found a candidate or not.
+ */
+@property (nonatomic, readonly) NSUInteger lookups;
+/** The number of frames resolved thanks to the cache.
+ */
+@property (nonatomic, readonly) NSUInteger hits;
+/** The number of frames that needed a full search.
+ */
+@property (nonatomic, readonly) NSUInteger misses;
+
+///---------------------------------------------------------------------------------------
+/// @name Initialization Methods
+///---------------------------------------------------------------------------------------
+
+/** Initialize a cache that holds up to 8 results.
+ *
+ * @return the cache instance.
+ */
+- (id)init;
+
+/** Initialize a cache with a given capacity.
+ *
+ * @param capacity the maximum number of results held by the cache.
+ * @return the cache instance.
+ */
+- (id)initWithCapacity:(NSUInteger)capacity;
+
+///---------------------------------------------------------------------------------------
+/// @name Cache Methods
+///---------------------------------------------------------------------------------------
+
+/** Find the cached result whose descriptor is the closest to the input one.
+ *
+ * @param hash the query frame descriptor.
+ * @return the cached result, or `nil` if there is no near-duplicate entry.
+ */
+- (MSResult *)resultForHash:(uint64_t)hash;
+
+/** Add a result to the cache, evicting the least recently used one if needed.
+ *
+ * @param result the recognized result.
+ * @param hash the descriptor of the frame that led to this result.
+ */
+- (void)addResult:(MSResult *)result forHash:(uint64_t)hash;
+
+/** Remove all the cached results. Counters are left untouched.
+ */
+- (void)removeAllResults;
+
+///---------------------------------------------------------------------------------------
+/// @name Statistics Methods
+///---------------------------------------------------------------------------------------
+
+/** Record how a frame has been resolved.
+ *
+ * @param hit `YES` if the frame has been resolved thanks to the cache, `NO` if a full
+ * search was needed.
+ * @param latency the time spent resolving the frame, in seconds.
+ */
+- (void)recordHit:(BOOL)hit latency:(NSTimeInterval)latency;
+
+/** Get the ratio of lookups that resolved a frame thanks to the cache.
+ *
+ * @return the hit rate in the [0..1] range.
+ */
+- (float)hitRate;
+
+/** Get the average time spent resolving a frame thanks to the cache, in seconds.
+ */
+- (NSTimeInterval)averageHitLatency;
+
+/** Get the average time spent resolving a frame with a full search, in seconds.
+ */
+- (NSTimeInterval)averageMissLatency;
+
+/** Reset all counters.
+ */
+- (void)resetStats;
+
+@end
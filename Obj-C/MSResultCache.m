@@ -0,0 +1,192 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "MSResultCache.h"
+#import "MSQuality.h"
+#import "MSObjC.h"
+
+static const NSUInteger kMSResultCacheCapacity = 8;
+static const int kMSResultCacheMaxDistance = 10;
+
+/** A cache entry.
+ */
+@interface MSResultCacheEntry : NSObject {
+@public
+    uint64_t _hash;
+    MSResult *_result;
+}
+@end
+
+@implementation MSResultCacheEntry
+
+- (void)dealloc {
+    [_result release_stub];
+    _result = nil;
+
+#if ! __has_feature(objc_arc)
+    [super dealloc];
+#endif
+}
+
+@end
+
+@implementation MSResultCache
+
+@synthesize capacity = _capacity;
+@synthesize maxDistance = _maxDistance;
+
+- (id)init {
+    return [self initWithCapacity:kMSResultCacheCapacity];
+}
+
+- (id)initWithCapacity:(NSUInteger)capacity {
+    self = [super init];
+    if (self) {
+        _capacity = (capacity > 0) ? capacity : 1;
+        _entries = [[NSMutableArray alloc] initWithCapacity:_capacity];
+        _maxDistance = kMSResultCacheMaxDistance;
+        [self resetStats];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_entries release_stub];
+    _entries = nil;
+
+#if ! __has_feature(objc_arc)
+    [super dealloc];
+#endif
+}
+
+- (MSResult *)resultForHash:(uint64_t)hash {
+    MSResult *result = nil;
+    @synchronized(self) {
+        _lookups++;
+        MSResultCacheEntry *best = nil;
+        int bestDistance = _maxDistance + 1;
+        for (MSResultCacheEntry *entry in _entries) {
+            int d = MSQualityHashDistance(hash, entry->_hash);
+            if (d < bestDistance) {
+                best = entry;
+                bestDistance = d;
+            }
+        }
+        if (best != nil) {
+            // Most recently used entries come first
+            [best retain_stub];
+            [_entries removeObjectIdenticalTo:best];
+            [_entries insertObject:best atIndex:0];
+            [best release_stub];
+            result = [[best->_result retain_stub] autorelease_stub];
+        }
+    }
+    return result;
+}
+
+- (void)addResult:(MSResult *)result forHash:(uint64_t)hash {
+    if (result == nil) return;
+    @synchronized(self) {
+        for (NSInteger i = [_entries count] - 1; i >= 0; i--) {
+            MSResultCacheEntry *entry = [_entries objectAtIndex:i];
+            if ([entry->_result isEqualToResult:result])
+                [_entries removeObjectAtIndex:i];
+        }
+
+        MSResultCacheEntry *entry = [[MSResultCacheEntry alloc] init];
+        entry->_hash = hash;
+        entry->_result = [result copy];
+        [_entries insertObject:entry atIndex:0];
+        [entry release_stub];
+
+        while ([_entries count] > _capacity)
+            [_entries removeLastObject];
+    }
+}
+
+- (void)removeAllResults {
+    @synchronized(self) {
+        [_entries removeAllObjects];
+    }
+}
+
+- (void)recordHit:(BOOL)hit latency:(NSTimeInterval)latency {
+    @synchronized(self) {
+        if (hit) {
+            _hits++;
+            _hitTime += latency;
+        }
+        else {
+            _misses++;
+            _missTime += latency;
+        }
+    }
+}
+
+- (NSUInteger)lookups {
+    @synchronized(self) {
+        return _lookups;
+    }
+}
+
+- (NSUInteger)hits {
+    @synchronized(self) {
+        return _hits;
+    }
+}
+
+- (NSUInteger)misses {
+    @synchronized(self) {
+        return _misses;
+    }
+}
+
+- (float)hitRate {
+    @synchronized(self) {
+        return (_lookups > 0) ? (float) _hits / _lookups : 0;
+    }
+}
+
+- (NSTimeInterval)averageHitLatency {
+    @synchronized(self) {
+        return (_hits > 0) ? _hitTime / _hits : 0;
+    }
+}
+
+- (NSTimeInterval)averageMissLatency {
+    @synchronized(self) {
+        return (_misses > 0) ? _missTime / _misses : 0;
+    }
+}
+
+- (void)resetStats {
+    @synchronized(self) {
+        _lookups = 0;
+        _hits = 0;
+        _hitTime = 0;
+        _misses = 0;
+        _missTime = 0;
+    }
+}
+
+@end
@@ -25,10 +25,50 @@
 
 #include "moodstocks_sdk.h"
 
+#include <pthread.h>
+
 #import "MSImage.h"
 #import "MSResult.h"
+#import "MSStats.h"
+
+/** Maximum number of idle API handles kept by a scanner for reuse.
+ */
+#define MS_API_HANDLE_POOL_SIZE 2
+
+/** Maximum number of API searches run at the same time by a scanner. Further
+ * searches wait for a running one to complete.
+ */
+#define MS_API_SEARCH_MAX_CONCURRENT 4
+
+/** The block called when an API search completes.
+ *
+ * @param result the result if any, `nil` otherwise.
+ * @param error the error if the search failed, `nil` otherwise.
+ */
+typedef void (^MSApiSearchCompletion)(MSResult *result, NSError *error);
+
+/** Block called for each image identifier of the local database.
+ *
+ * @param uid the image identifier.
+ * @param stop set it to `YES` to stop the enumeration.
+ */
+typedef void (^MSScannerIDBlock)(NSString *uid, BOOL *stop);
 
 @protocol MSScannerDelegate;
+@protocol MSApiBackend;
+@class MSCascadeSearch;
+
+/** Helpers to time a processing stage outside of the scanner, see `recordStage:since:`.
+ */
+#if MS_STATS
+  #define MS_STATS_SCANNER_BEGIN(MS_scanner, MS_t) \
+    MS_STATS_BEGIN([(MS_scanner) statsEnabled], MS_t)
+  #define MS_STATS_SCANNER_END(MS_scanner, MS_stage, MS_t) \
+    [(MS_scanner) recordStage:(MS_stage) since:(MS_t)]
+#else
+  #define MS_STATS_SCANNER_BEGIN(MS_scanner, MS_t) ((void)0)
+  #define MS_STATS_SCANNER_END(MS_scanner, MS_stage, MS_t) ((void)0)
+#endif
 
 /** On-device image and barcode scanner.
  *
@@ -61,6 +101,13 @@
     NSOperationQueue *_syncQueue;
     NSMutableArray *_syncDelegates;
     NSOperationQueue *_searchQueue;
+    MSScannerStats _stats;
+    BOOL _statsEnabled;
+    id<MSApiBackend> _apiBackend;
+    ms_api_handle_t *_apiHandles[MS_API_HANDLE_POOL_SIZE];
+    int _apiHandleCount;
+    pthread_rwlock_t _scanLock;
+    BOOL _opened;
 }
 
 /** Internal scanner handle.
@@ -73,6 +120,21 @@
  */
 @property (nonatomic, readonly) NSMutableArray *syncDelegates;
 
+/** The flag to enable the collection of statistics (see `getStats:`).
+ *
+ * By default, this value is set to `NO`. Statistics can also be completely compiled
+ * out by defining `MS_STATS` to 0.
+ */
+@property (nonatomic, assign) BOOL statsEnabled;
+
+/** The backend used by `apiSearch:withDelegate:`.
+ *
+ * By default, this value is `nil` and server-side searches are sent to the
+ * Moodstocks API. Set it before starting any search, e.g. to a `MSMockApiBackend`
+ * to test the application under controlled network conditions.
+ */
+@property (nonatomic, strong) id<MSApiBackend> apiBackend;
+
 /** The main scanner instance (singleton).
  */
 + (MSScanner *)sharedInstance;
@@ -102,6 +164,31 @@
  */
 - (BOOL)openWithKey:(NSString *)key secret:(NSString *)secret filename:(NSString *)filename error:(NSError **)error;
 
+/** Similar to the above function, but seeds the database from a prebuilt database
+ * file the first time it is opened.
+ *
+ * Use it to ship the application with its image signatures, e.g. a database
+ * file synced beforehand on a development device and added to the application
+ * bundle, so that offline recognition works right after installation without
+ * waiting for a full sync. Further syncs only fetch the changes.
+ *
+ * The seed is copied into the caches directory, and only if no database exists
+ * there yet: it never overwrites a more recent database. If the seed turns out to
+ * be corrupted, it is discarded and an empty database is opened instead.
+ * @param key a valid Moodstocks API key
+ * @param secret a valid Moodstocks API secret
+ * @param filename the filename to use, without extension
+ * @param seedPath the path of the prebuilt database file, obtained with the same
+ * key/secret pair, or `nil` to open the database as is.
+ * @param error the pointer to the error object, if any.
+ * @return `YES` if it succeeded, `NO` otherwise.
+ */
+- (BOOL)openWithKey:(NSString *)key
+             secret:(NSString *)secret
+           filename:(NSString *)filename
+               seed:(NSString *)seedPath
+              error:(NSError **)error;
+
 /** Close the scanner and disconnect it from the database file.
  *
  * @param error the pointer to the error object, if any.
@@ -109,6 +196,45 @@
  */
 - (BOOL)close:(NSError **)error;
 
+/** Close the scanner and remove its database file.
+ *
+ * Use it to free the disk space used by image signatures that are no longer
+ * needed. Opening the scanner again starts from an empty database.
+ *
+ * @param error the pointer to the error object, if any.
+ * @return `YES` if it succeeded, `NO` otherwise.
+ */
+- (BOOL)clean:(NSError **)error;
+
+/** Release the memory that the scanner does not strictly need, such as idle API
+ * handles.
+ *
+ * This method is called automatically when the application receives a memory
+ * warning.
+ */
+- (void)releaseCaches;
+
+/** Get the size of the database file, which is a good estimate of the memory used by
+ * the opened scanner.
+ *
+ * @return the database file size in bytes, or 0 if the scanner has never been opened.
+ */
+- (unsigned long long)databaseSize;
+
+/** Get the scanner ready to search at full speed, in the background.
+ *
+ * The first searches after opening the scanner are slower, while the database is
+ * read from disk and internal structures are built. Call this method right after
+ * opening the scanner, e.g. at application launch, so that this cost is not paid by
+ * the first frames of the scan screen: it reads the database file ahead and runs a
+ * dummy search and decoding. Scans and `close:` wait for the dummy search and
+ * decoding to complete, and they are skipped if the scanner has been closed first.
+ *
+ * @param completion the block to call on the main thread once the scanner is warmed
+ * up, or `nil`.
+ */
+- (void)warmupWithCompletion:(void (^)(void))completion;
+
 ///---------------------------------------------------------------------------------------
 /// @name Synchronization Methods
 ///---------------------------------------------------------------------------------------
@@ -129,6 +255,20 @@
  */
 - (BOOL)isSyncing;
 
+/** Cancel the pending synchronization, if any.
+ *
+ * The synchronization stops at its next progress step, i.e. possibly after this
+ * method returns: use `waitUntilSyncFinished` before e.g. removing the database.
+ */
+- (void)cancelSync;
+
+/** Block until the pending synchronization, if any, has stopped.
+ *
+ * @warning **Note:** never call this method from the main thread, since the
+ * synchronization notifies its delegate there.
+ */
+- (void)waitUntilSyncFinished;
+
 ///---------------------------------------------------------------------------------------
 /// @name Information Methods
 ///---------------------------------------------------------------------------------------
@@ -143,10 +283,26 @@
 /** Get an array made of all images identifiers found into the local database.
  *
  * @param error the pointer to the error object, if any.
- * @return the array of `NSString` identifiers for each image found within the local database.
+ * @return the array of `NSString` identifiers for each image found within the local database,
+ * or `nil` if an error occurred.
  */
 - (NSArray *)info:(NSError **)error;
 
+/** Enumerate the images identifiers found into the local database.
+ *
+ * Each identifier is handed over to the block without any extra copy, and released
+ * right after the block returns unless retained by it, which makes it cheaper than
+ * `info:` to walk through a large database.
+ *
+ * @warning **Note:** the Moodstocks SDK still lists all the identifiers at once
+ * before the enumeration starts: only the memory used on top of it is reduced.
+ *
+ * @param block the block to call for each identifier.
+ * @param error the pointer to the error object, if any.
+ * @return `YES` if the enumeration succeeded, `NO` otherwise.
+ */
+- (BOOL)enumerateIDsUsingBlock:(MSScannerIDBlock)block error:(NSError **)error;
+
 ///---------------------------------------------------------------------------------------
 /// @name Server-side Image Matching Methods
 ///---------------------------------------------------------------------------------------
@@ -162,10 +318,75 @@
  */
 - (void)apiSearch:(MSImage *)qry withDelegate:(id<MSScannerDelegate>)delegate;
 
+/** Similar to the above function, but reports the outcome to a block.
+ *
+ * The search runs in the background, and the completion block is called on the
+ * main thread, exactly once, including when the search is cancelled.
+ *
+ * @param qry the query image.
+ * @param completion the block to call when the search completes.
+ * @return the search operation, that can be cancelled on its own with
+ * `[NSOperation cancel]`.
+ *
+ * @warning **Note:** this method requires an Internet connection.
+ */
+- (NSOperation *)apiSearch:(MSImage *)qry completion:(MSApiSearchCompletion)completion;
+
+/** Search an image on-device first, then on Moodstocks API if needed.
+ *
+ * The on-device search starts right away. If it does not find any result within
+ * `budget` seconds, the same query is also sent to Moodstocks API, and the first
+ * result found is reported: the other search is cancelled. Use it to recognize items
+ * that are not synced yet, without sending every query to the API.
+ *
+ * This method must be called from the main thread.
+ *
+ * @param qry the query image.
+ * @param options the on-device search options, as a bitwise-or of `ms_search_flag_t`.
+ * @param budget the time given to the on-device search before querying the API, in
+ * seconds.
+ * @param completion the block to call on the main thread with the first result found,
+ * or with no result once both searches are over.
+ * @return the cascade search, that can be cancelled with `[MSCascadeSearch cancel]`.
+ */
+- (MSCascadeSearch *)cascadeSearch:(MSImage *)qry
+                           options:(int)options
+                            budget:(NSTimeInterval)budget
+                        completion:(MSApiSearchCompletion)completion;
+
 /** Cancel any pending API search(es).
  */
 - (void)cancelApiSearch;
 
+/** Prepare the scanner to perform API searches.
+ *
+ * API searches reuse the handles, and the connections they hold, of previous
+ * searches. Call this method as soon as a server-side search becomes likely, e.g.
+ * when the scan screen shows up, so that the first search does not pay for the
+ * handle setup either. This method returns immediately.
+ */
+- (void)prewarmApiSearch;
+
+/** Get an API handle, recycled from a previous search if possible.
+ *
+ * You should never have to call this method directly, unless you perform API
+ * searches yourself with `ms_api_handle_search`.
+ *
+ * @param error the pointer to the error object, if any.
+ * @return the API handle, or `NULL` if it could not be obtained. It must be given
+ * back with `recycleApiHandle:` after use.
+ */
+- (ms_api_handle_t *)dequeueApiHandle:(NSError **)error;
+
+/** Give back an API handle obtained with `dequeueApiHandle:`.
+ *
+ * @param handle the API handle.
+ * @param reusable `YES` if the handle can be reused by another search, `NO` if it
+ * should be released, e.g. after a failed or cancelled search. It is released anyway
+ * if the scanner has been closed since it was obtained.
+ */
+- (void)recycleApiHandle:(ms_api_handle_t *)handle reusable:(BOOL)reusable;
+
 ///---------------------------------------------------------------------------------------
 /// @name On-device Image Matching Methods
 ///---------------------------------------------------------------------------------------
@@ -218,6 +439,55 @@
  */
 - (MSResult *)match2:(MSImage *)qry ref:(MSResult *)ref options:(int)options error:(NSError **)error;
 
+/** Match a query image against a local reference given by its ID.
+ *
+ * @param qry the query image.
+ * @param uid the ID of the local image to match against, e.g. as returned by an API
+ * search.
+ * @param error the pointer to the error object, if any. If the ID is not part of the
+ * local database, the error code is `MS_NOREC`.
+ * @return the result if both images match, `nil` otherwise.
+ */
+- (MSResult *)match:(MSImage *)qry uid:(NSString *)uid error:(NSError **)error;
+
+///---------------------------------------------------------------------------------------
+/// @name Statistics Methods
+///---------------------------------------------------------------------------------------
+
+/** Get a snapshot of the statistics collected since the last reset.
+ *
+ * For each processing stage this gives the number of calls, the cumulative and maximum
+ * durations and a histogram of durations with log2 buckets, as well as the number of
+ * frames that have been resolved without a full scan. See `MSStats.h`.
+ *
+ * It can be called while scanning: each figure is read atomically, but the stages
+ * being recorded at that time may only be partly accounted for.
+ *
+ * @param stats the pointer to the statistics to fill.
+ */
+- (void)getStats:(MSScannerStats *)stats;
+
+/** Reset all statistics.
+ */
+- (void)resetStats;
+
+/** Record the duration of a processing stage.
+ *
+ * This is used by the scanner session and operations, you should not have to call it.
+ *
+ * @param stage the stage that has been timed.
+ * @param start the timestamp at which the stage started, as returned by `MSStatsNow`.
+ */
+- (void)recordStage:(MSStage)stage since:(uint64_t)start;
+
+/** Count a frame that has been resolved without a full scan.
+ *
+ * This is used by the scanner session, you should not have to call it.
+ *
+ * @param exit the kind of early exit.
+ */
+- (void)recordEarlyExit:(MSEarlyExit)exit;
+
 ///---------------------------------------------------------------------------------------
 /// @name On-device Barcode Decoding Methods
 ///---------------------------------------------------------------------------------------
@@ -233,6 +503,27 @@
  */
 - (MSResult *)decode:(MSImage *)qry formats:(int)formats error:(NSError **)error;
 
+/** Perform on-device barcode decoding and return all the decoded barcodes.
+ *
+ * Unlike `decode:formats:error:` which stops at the first decoded barcode, this
+ * method returns the barcodes of each requested format found in the query image,
+ * e.g. an EAN-13 and a QR Code printed on the same package. Use `getCorners:` on
+ * each result to locate it within the frame.
+ *
+ * @param qry the query image.
+ * @param formats the flag that represents the formats to be decoded, as a bitwise-or
+ * of the barcode formats listed in `MSResult`.
+ * @param max the maximum number of results to return.
+ * @param error the pointer to the error object, if any. It is only set if no barcode
+ * could be decoded.
+ * @return the array of `MSResult` found (possibly empty), or `nil` if an error occurred
+ * and no barcode could be decoded.
+ *
+ * @warning **Note:** at most one barcode is returned per format. A format that fails
+ * to decode is skipped, and the barcodes decoded for the other formats are returned.
+ */
+- (NSArray *)decodeAll:(MSImage *)qry formats:(int)formats max:(NSUInteger)max error:(NSError **)error;
+
 @end
 
 /** Scanner protocol for asynchronous network operations.
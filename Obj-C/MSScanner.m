@@ -26,7 +26,9 @@
 #import "MSDebug.h"
 #import "MSSync.h"
 #import "MSApiSearch.h"
+#import "MSCascadeSearch.h"
 #import "MSObjC.h"
+#import "MSTrace.h"
 
 // Callbacks to create a non retaining array
 static const void *MSScannerRetainNoOp(CFAllocatorRef allocator, const void *value) { return value; }
@@ -35,11 +37,19 @@ static void MSScannerNoOp(CFAllocatorRef allocator, const void *value) { }
 static MSScanner *gMSScanner   = nil;
 static NSString *kMSDBFilename = @"ms";
 
+// Warm-up read size and dummy image dimensions
+static const size_t kMSWarmupChunkSize = 1 << 20;
+static const int kMSWarmupImageWidth = 640;
+static const int kMSWarmupImageHeight = 480;
+
 @interface MSScanner ()
 
 #if MS_SDK_REQUIREMENTS
 - (void)applicationWillLeaveForeground:(void *)ignored;
+- (void)applicationDidReceiveMemoryWarning:(void *)ignored;
+- (MSResult *)resultWithHandle:(ms_result_t *)res query:(MSImage *)qry;
 #endif
+- (void)releaseApiHandles;
 
 @end
 
@@ -47,6 +57,8 @@ static NSString *kMSDBFilename = @"ms";
 
 @synthesize handle = _scanner;
 @synthesize syncDelegates = _syncDelegates;
+@synthesize statsEnabled = _statsEnabled;
+@synthesize apiBackend = _apiBackend;
 
 + (MSScanner *)sharedInstance {
     if (!gMSScanner) {
@@ -59,6 +71,10 @@ static NSString *kMSDBFilename = @"ms";
     self = [super init];
     if (self) {
         _scanner = NULL;
+        _opened = NO;
+        // Calls into the scanner hold it for reading, and opening, closing or warming
+        // up for writing
+        pthread_rwlock_init(&_scanLock, NULL);
 #if MS_SDK_REQUIREMENTS
 
         // Instantiate the internal scanner object
@@ -78,6 +94,10 @@ static NSString *kMSDBFilename = @"ms";
                    selector:@selector(applicationWillLeaveForeground:)
                        name:UIApplicationWillTerminateNotification
                      object:nil];
+        [center addObserver:self
+                   selector:@selector(applicationDidReceiveMemoryWarning:)
+                       name:UIApplicationDidReceiveMemoryWarningNotification
+                     object:nil];
         
 #endif
         _syncQueue = [[NSOperationQueue alloc] init];
@@ -90,6 +110,11 @@ static NSString *kMSDBFilename = @"ms";
         _syncDelegates = (NSMutableArray *) CFArrayCreateMutable(nil, 0, &callbacks);
 #endif
         _searchQueue = [[NSOperationQueue alloc] init];
+        [_searchQueue setMaxConcurrentOperationCount:MS_API_SEARCH_MAX_CONCURRENT];
+        _statsEnabled = NO;
+        _apiBackend = nil;
+        _apiHandleCount = 0;
+        memset(&_stats, 0, sizeof(_stats));
     }
     return self;
 }
@@ -97,10 +122,13 @@ static NSString *kMSDBFilename = @"ms";
 - (void)dealloc {
     [[NSNotificationCenter defaultCenter] removeObserver:self];
 
+    [self releaseApiHandles];
+
 #if MS_SDK_REQUIREMENTS
     if (_scanner) ms_scanner_del(_scanner);
 #endif
     _scanner = NULL;
+    pthread_rwlock_destroy(&_scanLock);
     
     [_dbPath release_stub];
     _dbPath = nil;
@@ -113,6 +141,9 @@ static NSString *kMSDBFilename = @"ms";
     
     [_searchQueue release_stub];
     _searchQueue = nil;
+
+    [_apiBackend release_stub];
+    _apiBackend = nil;
     
 #if ! __has_feature(objc_arc)
     [super dealloc];
@@ -126,6 +157,14 @@ static NSString *kMSDBFilename = @"ms";
 }
 
 - (BOOL)openWithKey:(NSString *)key secret:(NSString *)secret filename:(NSString *)filename error:(NSError **)error {
+    return [self openWithKey:key secret:secret filename:filename seed:nil error:error];
+}
+
+- (BOOL)openWithKey:(NSString *)key
+             secret:(NSString *)secret
+           filename:(NSString *)filename
+               seed:(NSString *)seedPath
+              error:(NSError **)error {
     BOOL err = NO;
     
 #if MS_SDK_REQUIREMENTS
@@ -133,7 +172,16 @@ static NSString *kMSDBFilename = @"ms";
         NSArray *paths = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
         NSString *_cachesPath = [paths objectAtIndex:0];
         NSString *completeFilename = [NSString stringWithFormat:@"%@.db", filename];
+        [_dbPath release_stub];
         _dbPath = [[_cachesPath stringByAppendingPathComponent:completeFilename] retain_stub];
+
+        NSFileManager *fm = [NSFileManager defaultManager];
+        if (seedPath != nil && ![fm fileExistsAtPath:_dbPath]) {
+            // A failed copy is not fatal: an empty database gets created instead
+            [fm copyItemAtPath:seedPath toPath:_dbPath error:nil];
+        }
+
+        pthread_rwlock_wrlock(&_scanLock);
         ms_errcode ecode = ms_scanner_open(_scanner,
                                            [_dbPath UTF8String],
                                            [key UTF8String],
@@ -147,6 +195,8 @@ static NSString *kMSDBFilename = @"ms";
                                     [key UTF8String],
                                     [secret UTF8String]);
         }
+        _opened = (ecode == MS_SUCCESS);
+        pthread_rwlock_unlock(&_scanLock);
 
         if (ecode != MS_SUCCESS) {
             err = YES;
@@ -170,7 +220,13 @@ static NSString *kMSDBFilename = @"ms";
     BOOL err = NO;
 
 #if MS_SDK_REQUIREMENTS
+    // Wait for the pending scans and warm-up to complete. The pooled API handles
+    // are drained under the lock so that none gets recycled in between.
+    pthread_rwlock_wrlock(&_scanLock);
+    [self releaseApiHandles];
     ms_errcode ecode = ms_scanner_close(_scanner);
+    _opened = NO;
+    pthread_rwlock_unlock(&_scanLock);
     if (ecode != MS_SUCCESS) {
         err = YES;
         if (error != nil) {
@@ -182,6 +238,83 @@ static NSString *kMSDBFilename = @"ms";
     return !err;
 }
 
+- (BOOL)clean:(NSError **)error {
+    BOOL err = NO;
+
+#if MS_SDK_REQUIREMENTS
+    // Closing a scanner that is not opened is harmless here
+    pthread_rwlock_wrlock(&_scanLock);
+    [self releaseApiHandles];
+    ms_scanner_close(_scanner);
+    _opened = NO;
+    pthread_rwlock_unlock(&_scanLock);
+    if (_dbPath != nil) {
+        ms_errcode ecode = ms_scanner_clean([_dbPath UTF8String]);
+        if (ecode != MS_SUCCESS) {
+            err = YES;
+            if (error != nil) {
+                *error = [NSError errorWithDomain:@"moodstocks-sdk" code:ecode userInfo:nil];
+            }
+        }
+    }
+#endif
+
+    return !err;
+}
+
+- (void)releaseCaches {
+    [self releaseApiHandles];
+}
+
+- (unsigned long long)databaseSize {
+    if (_dbPath == nil) return 0;
+    NSDictionary *attrs = [[NSFileManager defaultManager] attributesOfItemAtPath:_dbPath error:nil];
+    return [attrs fileSize];
+}
+
+- (void)warmupWithCompletion:(void (^)(void))completion {
+#if MS_SDK_REQUIREMENTS
+    NSString *dbPath = [[_dbPath retain_stub] autorelease_stub];
+#endif
+    void (^done)(void) = [[completion copy] autorelease_stub];
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0), ^{
+#if MS_SDK_REQUIREMENTS
+        // Page the database file in, sequentially
+        FILE *f = (dbPath != nil) ? fopen([dbPath fileSystemRepresentation], "rb") : NULL;
+        if (f) {
+            char *chunk = MSMalloc(kMSWarmupChunkSize);
+            while (chunk && fread(chunk, 1, kMSWarmupChunkSize, f) == kMSWarmupChunkSize);
+            MSFree(chunk);
+            fclose(f);
+        }
+
+        // Build the lazily initialized structures. The scanner API is bypassed so
+        // that statistics are left untouched. Scans wait for it, and it is skipped if
+        // the scanner has been closed in the meantime.
+        pthread_rwlock_wrlock(&_scanLock);
+        unsigned char *blank = MSMalloc(kMSWarmupImageWidth * kMSWarmupImageHeight);
+        if (blank) memset(blank, 0, kMSWarmupImageWidth * kMSWarmupImageHeight);
+        ms_img_t *img = NULL;
+        if (_opened && blank && ms_img_new(blank, kMSWarmupImageWidth, kMSWarmupImageHeight,
+                                kMSWarmupImageWidth, MS_PIX_FMT_GRAY8,
+                                MS_TOP_LEFT_ORI, &img) == MS_SUCCESS) {
+            ms_result_t *res = NULL;
+            if (ms_scanner_search(_scanner, img, &res) == MS_SUCCESS && res)
+                ms_result_del(res);
+            res = NULL;
+            int formats = MS_RESULT_TYPE_EAN8 | MS_RESULT_TYPE_EAN13 |
+                          MS_RESULT_TYPE_QRCODE | MS_RESULT_TYPE_DMTX;
+            if (ms_scanner_decode(_scanner, img, formats, &res) == MS_SUCCESS && res)
+                ms_result_del(res);
+            ms_img_del(img);
+        }
+        pthread_rwlock_unlock(&_scanLock);
+        MSFree(blank);
+#endif
+        if (done) dispatch_async(dispatch_get_main_queue(), done);
+    });
+}
+
 - (void)syncWithDelegate:(id<MSScannerDelegate>)delegate {
 #if MS_SDK_REQUIREMENTS
     MSSync *op = [[[MSSync alloc] initWithScanner:self] autorelease_stub];
@@ -194,6 +327,10 @@ static NSString *kMSDBFilename = @"ms";
     [_syncQueue cancelAllOperations];
 }
 
+- (void)waitUntilSyncFinished {
+    [_syncQueue waitUntilAllOperationsAreFinished];
+}
+
 - (BOOL)isSyncing {
     return !!([_syncQueue operationCount] >= 1);
 }
@@ -202,7 +339,9 @@ static NSString *kMSDBFilename = @"ms";
     int cnt;
     
 #if MS_SDK_REQUIREMENTS
+    pthread_rwlock_rdlock(&_scanLock);
     ms_errcode ecode = ms_scanner_info(_scanner, &cnt, NULL);
+    pthread_rwlock_unlock(&_scanLock);
     if (ecode != MS_SUCCESS && ecode != MS_EMPTY) {
         cnt = -1;
         if (error != nil) {
@@ -219,29 +358,64 @@ static NSString *kMSDBFilename = @"ms";
 }
 
 - (NSArray *)info:(NSError **)error {
-    NSMutableArray *ary = nil;
-    
+    NSMutableArray *ary = [NSMutableArray array];
+    BOOL ok = [self enumerateIDsUsingBlock:^(NSString *uid, BOOL *stop) {
+        [ary addObject:uid];
+    } error:error];
+    return ok ? ary : nil;
+}
+
+- (BOOL)enumerateIDsUsingBlock:(MSScannerIDBlock)block error:(NSError **)error {
 #if MS_SDK_REQUIREMENTS
-    ary = [NSMutableArray arrayWithCapacity:[self count:nil]];
-    int cnt;
+    int cnt = 0;
     char **ids = NULL;
+    pthread_rwlock_rdlock(&_scanLock);
     ms_errcode ecode = ms_scanner_info(_scanner, &cnt, &ids);
+    pthread_rwlock_unlock(&_scanLock);
     if (ecode != MS_SUCCESS && ecode != MS_EMPTY) {
         if (error != nil) {
             *error = [NSError errorWithDomain:@"moodstocks-sdk" code:ecode userInfo:nil];
         }
+        return NO;
     }
-    else if (ids != NULL) {
-        for (int i = 0; i < cnt; i++) {
-            [ary addObject:[NSString stringWithCString:ids[i] encoding:NSUTF8StringEncoding]];
+    if (ids == NULL)
+        return YES;
+
+    BOOL stop = NO;
+    for (int i = 0; i < cnt; i++) {
+        if (stop) {
             free(ids[i]);
+            continue;
+        }
+#if __has_feature(objc_arc)
+        @autoreleasepool {
+#else
+        NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+#endif
+        // The string takes ownership of the identifier: no copy is made
+        NSString *uid = [[NSString alloc] initWithBytesNoCopy:ids[i]
+                                                       length:strlen(ids[i])
+                                                     encoding:NSUTF8StringEncoding
+                                                 freeWhenDone:YES];
+        if (uid != nil) {
+            block(uid, &stop);
+            [uid release_stub];
         }
+        else {
+            free(ids[i]);
+        }
+#if __has_feature(objc_arc)
+        } /* end of @autoreleasepool block */
+#else
+        [pool release];
+#endif
     }
-    
-    if (ids != NULL) free(ids);
+
+    free(ids);
+    return YES;
+#else
+    return NO;
 #endif
-    
-    return ary;
 }
 
 
@@ -250,11 +424,16 @@ static NSString *kMSDBFilename = @"ms";
 
 #if MS_SDK_REQUIREMENTS
     ms_result_t *res = NULL;
+    MS_TRACE_BEGIN("search");
+    MS_STATS_BEGIN(_statsEnabled, t0);
+    pthread_rwlock_rdlock(&_scanLock);
     ms_errcode ecode = ms_scanner_search(_scanner, [qry image], &res);
+    pthread_rwlock_unlock(&_scanLock);
+    MS_STATS_END(_statsEnabled, &_stats, MS_STAGE_SEARCH, t0);
+    MS_TRACE_END("search");
     if (ecode == MS_SUCCESS) {
         if (res != NULL) {
-            result = [[[MSResult alloc] initWithResult:res] autorelease_stub];
-            ms_result_del(res);
+            result = [self resultWithHandle:res query:qry];
         }
     }
     else if (error) {
@@ -270,11 +449,16 @@ static NSString *kMSDBFilename = @"ms";
     
 #if MS_SDK_REQUIREMENTS
     ms_result_t *res = NULL;
+    MS_TRACE_BEGIN("search");
+    MS_STATS_BEGIN(_statsEnabled, t0);
+    pthread_rwlock_rdlock(&_scanLock);
     ms_errcode ecode = ms_scanner_search2(_scanner, [qry image], &res, options);
+    pthread_rwlock_unlock(&_scanLock);
+    MS_STATS_END(_statsEnabled, &_stats, MS_STAGE_SEARCH, t0);
+    MS_TRACE_END("search");
     if (ecode == MS_SUCCESS) {
         if (res != NULL) {
-            result = [[[MSResult alloc] initWithResult:res] autorelease_stub];
-            ms_result_del(res);
+            result = [self resultWithHandle:res query:qry];
         }
     }
     else if (error) {
@@ -290,11 +474,16 @@ static NSString *kMSDBFilename = @"ms";
 #if MS_SDK_REQUIREMENTS
     const char *uid = [[ref getData] bytes];
     ms_result_t *res = NULL;
+    MS_TRACE_BEGIN("match");
+    MS_STATS_BEGIN(_statsEnabled, t0);
+    pthread_rwlock_rdlock(&_scanLock);
     ms_errcode ecode = ms_scanner_match(_scanner, [qry image], uid, &res);
+    pthread_rwlock_unlock(&_scanLock);
+    MS_STATS_END(_statsEnabled, &_stats, MS_STAGE_MATCH, t0);
+    MS_TRACE_END("match");
     if (ecode == MS_SUCCESS) {
         if (res != NULL) {
-            result = [[[MSResult alloc] initWithResult:res] autorelease_stub];
-            ms_result_del(res);
+            result = [self resultWithHandle:res query:qry];
         }
     }
     else if (error) {
@@ -310,11 +499,40 @@ static NSString *kMSDBFilename = @"ms";
 #if MS_SDK_REQUIREMENTS
     const char *uid = [[ref getData] bytes];
     ms_result_t *res = NULL;
+    MS_TRACE_BEGIN("match");
+    MS_STATS_BEGIN(_statsEnabled, t0);
+    pthread_rwlock_rdlock(&_scanLock);
     ms_errcode ecode = ms_scanner_match2(_scanner, [qry image], uid, &res, options);
+    pthread_rwlock_unlock(&_scanLock);
+    MS_STATS_END(_statsEnabled, &_stats, MS_STAGE_MATCH, t0);
+    MS_TRACE_END("match");
+    if (ecode == MS_SUCCESS) {
+        if (res != NULL) {
+            result = [self resultWithHandle:res query:qry];
+        }
+    }
+    else if (error) {
+        *error = [NSError errorWithDomain:@"moodstocks-sdk" code:ecode userInfo:nil];
+    }
+#endif
+    
+    return result;
+}
+
+- (MSResult *)match:(MSImage *)qry uid:(NSString *)uid error:(NSError **)error {
+    MSResult *result = nil;
+#if MS_SDK_REQUIREMENTS
+    ms_result_t *res = NULL;
+    MS_TRACE_BEGIN("match");
+    MS_STATS_BEGIN(_statsEnabled, t0);
+    pthread_rwlock_rdlock(&_scanLock);
+    ms_errcode ecode = ms_scanner_match(_scanner, [qry image], [uid UTF8String], &res);
+    pthread_rwlock_unlock(&_scanLock);
+    MS_STATS_END(_statsEnabled, &_stats, MS_STAGE_MATCH, t0);
+    MS_TRACE_END("match");
     if (ecode == MS_SUCCESS) {
         if (res != NULL) {
-            result = [[[MSResult alloc] initWithResult:res] autorelease_stub];
-            ms_result_del(res);
+            result = [self resultWithHandle:res query:qry];
         }
     }
     else if (error) {
@@ -333,20 +551,98 @@ static NSString *kMSDBFilename = @"ms";
 #endif
 }
 
+- (NSOperation *)apiSearch:(MSImage *)qry completion:(MSApiSearchCompletion)completion {
+    MSApiSearch *op = [[[MSApiSearch alloc] initWithScanner:self query:qry] autorelease_stub];
+    [op setCompletion:completion];
+#if MS_SDK_REQUIREMENTS
+    [_searchQueue addOperation:op];
+#else
+    NSError *error = [NSError errorWithDomain:@"moodstocks-sdk" code:0xbadef1ce /* bad device */ userInfo:nil];
+    if (completion) completion(nil, error);
+#endif
+    return op;
+}
+
+- (MSCascadeSearch *)cascadeSearch:(MSImage *)qry
+                           options:(int)options
+                            budget:(NSTimeInterval)budget
+                        completion:(MSApiSearchCompletion)completion {
+    MSCascadeSearch *search = [[[MSCascadeSearch alloc] initWithScanner:self
+                                                                   query:qry
+                                                                 options:options
+                                                                  budget:budget] autorelease_stub];
+    [search startWithCompletion:completion];
+    return search;
+}
+
 - (void)cancelApiSearch {
     [_searchQueue cancelAllOperations];
 }
 
+- (void)prewarmApiSearch {
+#if MS_SDK_REQUIREMENTS
+    [_searchQueue addOperationWithBlock:^{
+        ms_api_handle_t *handle = [self dequeueApiHandle:nil];
+        if (handle) [self recycleApiHandle:handle reusable:YES];
+    }];
+#endif
+}
+
+- (ms_api_handle_t *)dequeueApiHandle:(NSError **)error {
+    ms_api_handle_t *handle = NULL;
+#if MS_SDK_REQUIREMENTS
+    @synchronized(self) {
+        if (_apiHandleCount > 0)
+            handle = _apiHandles[--_apiHandleCount];
+    }
+    if (handle == NULL) {
+        pthread_rwlock_rdlock(&_scanLock);
+        ms_errcode ecode = ms_scanner_api_handle(_scanner, &handle);
+        pthread_rwlock_unlock(&_scanLock);
+        if (ecode != MS_SUCCESS) {
+            handle = NULL;
+            if (error) {
+                *error = [NSError errorWithDomain:@"moodstocks-sdk" code:ecode userInfo:nil];
+            }
+        }
+    }
+#endif
+    return handle;
+}
+
+- (void)recycleApiHandle:(ms_api_handle_t *)handle reusable:(BOOL)reusable {
+#if MS_SDK_REQUIREMENTS
+    if (handle == NULL) return;
+    // A handle obtained before the scanner got closed must not outlive it in the pool
+    pthread_rwlock_rdlock(&_scanLock);
+    if (reusable && _opened) {
+        @synchronized(self) {
+            if (_apiHandleCount < MS_API_HANDLE_POOL_SIZE) {
+                _apiHandles[_apiHandleCount++] = handle;
+                handle = NULL;
+            }
+        }
+    }
+    pthread_rwlock_unlock(&_scanLock);
+    if (handle) ms_api_handle_release(handle);
+#endif
+}
+
 - (MSResult *)decode:(MSImage *)qry formats:(int)formats error:(NSError **)error {
     MSResult *result = nil;
 
 #if MS_SDK_REQUIREMENTS
     ms_result_t *barcode = NULL;
+    MS_TRACE_BEGIN("decode");
+    MS_STATS_BEGIN(_statsEnabled, t0);
+    pthread_rwlock_rdlock(&_scanLock);
     ms_errcode ecode = ms_scanner_decode(_scanner, [qry image], formats, &barcode);
+    pthread_rwlock_unlock(&_scanLock);
+    MS_STATS_END(_statsEnabled, &_stats, MS_STAGE_DECODE, t0);
+    MS_TRACE_END("decode");
     if (ecode == MS_SUCCESS) {
         if (barcode != NULL) {
-            result = [[[MSResult alloc] initWithResult:barcode] autorelease_stub];
-            ms_result_del(barcode);
+            result = [self resultWithHandle:barcode query:qry];
         }
     }
     else if (error) {
@@ -357,6 +653,88 @@ static NSString *kMSDBFilename = @"ms";
     return result;
 }
 
+- (NSArray *)decodeAll:(MSImage *)qry formats:(int)formats max:(NSUInteger)max error:(NSError **)error {
+    NSMutableArray *results = [NSMutableArray array];
+
+#if MS_SDK_REQUIREMENTS
+    static const int kBarcodeFormats[] = {
+        MS_RESULT_TYPE_EAN8,
+        MS_RESULT_TYPE_EAN13,
+        MS_RESULT_TYPE_QRCODE,
+        MS_RESULT_TYPE_DMTX
+    };
+
+    ms_errcode lastError = MS_SUCCESS;
+    for (int i = 0; i < 4 && [results count] < max; i++) {
+        if (!(formats & kBarcodeFormats[i])) continue;
+        ms_result_t *barcode = NULL;
+        MS_TRACE_BEGIN("decode");
+        MS_STATS_BEGIN(_statsEnabled, t0);
+        pthread_rwlock_rdlock(&_scanLock);
+        ms_errcode ecode = ms_scanner_decode(_scanner, [qry image], kBarcodeFormats[i], &barcode);
+        pthread_rwlock_unlock(&_scanLock);
+        MS_STATS_END(_statsEnabled, &_stats, MS_STAGE_DECODE, t0);
+        MS_TRACE_END("decode");
+        if (ecode != MS_SUCCESS) {
+            // Keep going with the other formats
+            lastError = ecode;
+            continue;
+        }
+        if (barcode != NULL) {
+            [results addObject:[self resultWithHandle:barcode query:qry]];
+        }
+    }
+
+    if (lastError != MS_SUCCESS && [results count] == 0) {
+        if (error) {
+            *error = [NSError errorWithDomain:@"moodstocks-sdk" code:lastError userInfo:nil];
+        }
+        return nil;
+    }
+#endif
+
+    return results;
+}
+
+- (void)getStats:(MSScannerStats *)stats {
+    MSStatsCopy(stats, &_stats);
+}
+
+- (void)resetStats {
+    MSStatsReset(&_stats);
+}
+
+- (void)recordStage:(MSStage)stage since:(uint64_t)start {
+#if MS_STATS
+    if (_statsEnabled) MSStatsRecord(&_stats, stage, start);
+#endif
+}
+
+- (void)recordEarlyExit:(MSEarlyExit)exit {
+#if MS_STATS
+    if (_statsEnabled) MSStatsExit(&_stats, exit);
+#endif
+}
+
+#pragma mark - Private
+
+#if MS_SDK_REQUIREMENTS
+- (MSResult *)resultWithHandle:(ms_result_t *)res query:(MSImage *)qry {
+    MSResult *result = [[[MSResult alloc] initWithResultNoCopy:res] autorelease_stub];
+    [result setRegion:[qry region]];
+    return result;
+}
+#endif
+
+- (void)releaseApiHandles {
+#if MS_SDK_REQUIREMENTS
+    @synchronized(self) {
+        while (_apiHandleCount > 0)
+            ms_api_handle_release(_apiHandles[--_apiHandleCount]);
+    }
+#endif
+}
+
 #pragma mark - NSNotifications
 
 #if MS_SDK_REQUIREMENTS
@@ -366,6 +744,10 @@ static NSString *kMSDBFilename = @"ms";
         MSDLog(@" [APP EXIT] SCANNER CLOSE ERROR: %@", MSErrMsg([err code]));
     }
 }
+
+- (void)applicationDidReceiveMemoryWarning:(void *)ignored {
+    [self releaseCaches];
+}
 #endif
 
 @end
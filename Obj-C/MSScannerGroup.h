@@ -0,0 +1,158 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+
+#import "MSScanner.h"
+#import "MSImage.h"
+#import "MSResult.h"
+
+#include <pthread.h>
+
+/** A group of scanners, a.k.a shards, searched in parallel.
+ *
+ * Each shard is a regular `MSScanner` bound to its own database file, typically one
+ * per collection (API key / secret pair) of a large catalog. Shards can be synced
+ * independently, and an image search is performed over all the shards at once, so
+ * that its latency depends on the largest shard rather than on the whole catalog.
+ *
+ * Since the scanner reports no match score, when several shards find a result the
+ * one of the shard added first wins: add the shards by decreasing priority.
+ */
+@interface MSScannerGroup : NSObject {
+    NSMutableArray *_shards;
+    unsigned long long _memoryBudget;
+    pthread_rwlock_t _searchLock;
+}
+
+/** The shards, in priority order, including the parked ones.
+ */
+@property (nonatomic, readonly) NSArray *shards;
+
+/** The maximum memory used by the opened shards, in bytes, as estimated from the size
+ * of their database files (see `[MSScanner databaseSize]`).
+ *
+ * When a shard is added or the application receives a memory warning, the least
+ * recently successful shards are *parked*, i.e. closed, until the budget is met.
+ * Parked shards are not searched until `restoreShards` is called. At least one
+ * shard is always kept opened, and shards being synced are never parked. Parking
+ * waits for the pending searches to complete.
+ *
+ * By default, this value is set to 0, which means no limit.
+ */
+@property (nonatomic, assign) unsigned long long memoryBudget;
+
+///---------------------------------------------------------------------------------------
+/// @name Shards Management
+///---------------------------------------------------------------------------------------
+
+/** Open a new scanner and add it as the lowest priority shard.
+ *
+ * @param key a valid Moodstocks API key
+ * @param secret a valid Moodstocks API secret
+ * @param filename the filename to use for the shard database, without extension. It
+ * must differ from the filename of the other shards.
+ * @param error the pointer to the error object, if any.
+ * @return the new shard, or `nil` if it could not be opened.
+ */
+- (MSScanner *)addShardWithKey:(NSString *)key
+                        secret:(NSString *)secret
+                      filename:(NSString *)filename
+                         error:(NSError **)error;
+
+/** Close a shard, remove its database file and remove it from the group.
+ *
+ * Use it to drop a collection that is no longer relevant, e.g. when the user moves
+ * to another store or region. The other shards are left untouched. The pending
+ * searches are completed first. If the shard is being synced, its synchronization
+ * is cancelled and its database file is removed in the background once it is over.
+ *
+ * @param shard the shard to evict.
+ * @param error the pointer to the error object, if any.
+ * @return `YES` if it succeeded, `NO` otherwise.
+ */
+- (BOOL)evictShard:(MSScanner *)shard error:(NSError **)error;
+
+/** Close all the shards and remove them from the group.
+ */
+- (void)close;
+
+/** Check whether a shard has been parked to meet the memory budget.
+ *
+ * @param shard the shard.
+ * @return `YES` if the shard is parked, `NO` otherwise.
+ */
+- (BOOL)isShardParked:(MSScanner *)shard;
+
+/** Park the least recently successful shards until the memory budget is met.
+ *
+ * This method is called automatically when the application receives a memory
+ * warning.
+ */
+- (void)releaseMemory;
+
+/** Re-open the parked shards, by priority, as long as the memory budget allows it.
+ *
+ * Call it when memory is available again, e.g. when the scan screen shows up.
+ */
+- (void)restoreShards;
+
+///---------------------------------------------------------------------------------------
+/// @name Synchronization Methods
+///---------------------------------------------------------------------------------------
+
+/** Synchronize all the opened shards, concurrently.
+ *
+ * Each shard is synced on its own, as with `[MSScanner syncWithDelegate:]`: the
+ * delegate is notified once per shard, with the shard as scanner argument.
+ *
+ * @param delegate the delegate that will be notified with the synchronization events.
+ */
+- (void)syncWithDelegate:(id<MSScannerDelegate>)delegate;
+
+/** Cancel the pending synchronizations of all the shards.
+ */
+- (void)cancelSync;
+
+///---------------------------------------------------------------------------------------
+/// @name Search Methods
+///---------------------------------------------------------------------------------------
+
+/** Search an image over all the shards, in parallel.
+ *
+ * This method is synchronous: it returns once every shard has been searched.
+ *
+ * @param qry the query image.
+ * @param options a bitwise-OR combination of the `ms_search_flag_t` options.
+ * @param shard the pointer to a variable into which the index of the shard that found
+ * the result will be assigned, if any.
+ * @param error the pointer to the error object, if any. An error is only reported if
+ * no result has been found and at least one shard failed.
+ * @return the result of the highest priority shard that found one, `nil` otherwise.
+ */
+- (MSResult *)search:(MSImage *)qry
+             options:(int)options
+               shard:(NSUInteger *)shard
+               error:(NSError **)error;
+
+@end
@@ -0,0 +1,351 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "MSScannerGroup.h"
+#import "MSAvailability.h"
+#import "MSAlloc.h"
+#import "MSObjC.h"
+
+#if MS_IPHONE_OS_REQUIREMENTS
+  #import <UIKit/UIKit.h>
+#endif
+
+/** A shard and what is needed to re-open it once parked.
+ */
+@interface MSScannerGroupShard : NSObject {
+@public
+    MSScanner *_scanner;
+    NSString *_key;
+    NSString *_secret;
+    NSString *_filename;
+    CFAbsoluteTime _lastHit;
+    BOOL _parked;
+}
+@end
+
+@implementation MSScannerGroupShard
+
+- (void)dealloc {
+    [_scanner release_stub];
+    _scanner = nil;
+    [_key release_stub];
+    _key = nil;
+    [_secret release_stub];
+    _secret = nil;
+    [_filename release_stub];
+    _filename = nil;
+
+#if ! __has_feature(objc_arc)
+    [super dealloc];
+#endif
+}
+
+@end
+
+@interface MSScannerGroup ()
+- (NSArray *)openedShards;
+- (MSScannerGroupShard *)entryForShard:(MSScanner *)shard;
+- (void)applicationDidReceiveMemoryWarning:(void *)ignored;
+@end
+
+@implementation MSScannerGroup
+
+@synthesize memoryBudget = _memoryBudget;
+
+- (id)init {
+    self = [super init];
+    if (self) {
+        _shards = [[NSMutableArray alloc] init];
+        _memoryBudget = 0;
+        // Searches hold it for reading, and closing or re-opening shards for writing
+        pthread_rwlock_init(&_searchLock, NULL);
+
+#if MS_IPHONE_OS_REQUIREMENTS
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(applicationDidReceiveMemoryWarning:)
+                                                     name:UIApplicationDidReceiveMemoryWarningNotification
+                                                   object:nil];
+#endif
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+
+    [_shards release_stub];
+    _shards = nil;
+
+    pthread_rwlock_destroy(&_searchLock);
+
+#if ! __has_feature(objc_arc)
+    [super dealloc];
+#endif
+}
+
+- (NSArray *)shards {
+    NSMutableArray *shards = [NSMutableArray array];
+    @synchronized(self) {
+        for (MSScannerGroupShard *entry in _shards)
+            [shards addObject:entry->_scanner];
+    }
+    return shards;
+}
+
+- (MSScanner *)addShardWithKey:(NSString *)key
+                        secret:(NSString *)secret
+                      filename:(NSString *)filename
+                         error:(NSError **)error {
+    MSScanner *shard = [[[MSScanner alloc] init] autorelease_stub];
+    if (![shard openWithKey:key secret:secret filename:filename error:error])
+        return nil;
+
+    MSScannerGroupShard *entry = [[MSScannerGroupShard alloc] init];
+    entry->_scanner = [shard retain_stub];
+    entry->_key = [key copy];
+    entry->_secret = [secret copy];
+    entry->_filename = [filename copy];
+    entry->_lastHit = CFAbsoluteTimeGetCurrent();
+    entry->_parked = NO;
+    @synchronized(self) {
+        [_shards addObject:entry];
+    }
+    [entry release_stub];
+
+    [self releaseMemory];
+    return shard;
+}
+
+- (BOOL)evictShard:(MSScanner *)shard error:(NSError **)error {
+    MSScannerGroupShard *entry = [self entryForShard:shard];
+    if (entry == nil) return NO;
+
+    [[entry retain_stub] autorelease_stub];
+    // Wait for the pending searches to complete before closing it
+    pthread_rwlock_wrlock(&_searchLock);
+    @synchronized(self) {
+        [_shards removeObjectIdenticalTo:entry];
+    }
+    pthread_rwlock_unlock(&_searchLock);
+
+    if ([shard isSyncing]) {
+        // The sync only stops at its next progress step: remove the database once
+        // it is over. The block keeps the shard alive until then.
+        [shard cancelSync];
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0), ^{
+            [shard waitUntilSyncFinished];
+            [shard clean:nil];
+        });
+        return YES;
+    }
+    return [shard clean:error];
+}
+
+- (void)close {
+    NSArray *shards = nil;
+    pthread_rwlock_wrlock(&_searchLock);
+    @synchronized(self) {
+        shards = [NSArray arrayWithArray:_shards];
+        [_shards removeAllObjects];
+    }
+    for (MSScannerGroupShard *entry in shards) {
+        if (!entry->_parked) [entry->_scanner close:nil];
+    }
+    pthread_rwlock_unlock(&_searchLock);
+}
+
+- (BOOL)isShardParked:(MSScanner *)shard {
+    MSScannerGroupShard *entry = [self entryForShard:shard];
+    return (entry != nil) ? entry->_parked : NO;
+}
+
+- (void)releaseMemory {
+    if (_memoryBudget == 0) return;
+
+    pthread_rwlock_wrlock(&_searchLock);
+    @synchronized(self) {
+        unsigned long long total = 0;
+        NSUInteger opened = 0;
+        for (MSScannerGroupShard *entry in _shards) {
+            if (entry->_parked) continue;
+            total += [entry->_scanner databaseSize];
+            opened++;
+        }
+
+        while (total > _memoryBudget && opened > 1) {
+            MSScannerGroupShard *coldest = nil;
+            for (MSScannerGroupShard *entry in _shards) {
+                if (entry->_parked || [entry->_scanner isSyncing]) continue;
+                if (coldest == nil || entry->_lastHit < coldest->_lastHit)
+                    coldest = entry;
+            }
+            if (coldest == nil) break;
+
+            total -= [coldest->_scanner databaseSize];
+            opened--;
+            [coldest->_scanner close:nil];
+            coldest->_parked = YES;
+        }
+    }
+    pthread_rwlock_unlock(&_searchLock);
+}
+
+- (void)restoreShards {
+    pthread_rwlock_wrlock(&_searchLock);
+    @synchronized(self) {
+        unsigned long long total = 0;
+        for (MSScannerGroupShard *entry in _shards) {
+            if (!entry->_parked) total += [entry->_scanner databaseSize];
+        }
+
+        for (MSScannerGroupShard *entry in _shards) {
+            if (!entry->_parked) continue;
+            unsigned long long size = [entry->_scanner databaseSize];
+            if (_memoryBudget > 0 && total + size > _memoryBudget) continue;
+            if ([entry->_scanner openWithKey:entry->_key
+                                      secret:entry->_secret
+                                    filename:entry->_filename
+                                       error:nil]) {
+                entry->_parked = NO;
+                entry->_lastHit = CFAbsoluteTimeGetCurrent();
+                total += size;
+            }
+        }
+    }
+    pthread_rwlock_unlock(&_searchLock);
+}
+
+- (void)syncWithDelegate:(id<MSScannerDelegate>)delegate {
+    for (MSScanner *shard in [self openedShards])
+        [shard syncWithDelegate:delegate];
+}
+
+- (void)cancelSync {
+    for (MSScanner *shard in [self shards])
+        [shard cancelSync];
+}
+
+- (MSResult *)search:(MSImage *)qry
+             options:(int)options
+               shard:(NSUInteger *)shard
+               error:(NSError **)error {
+    // Keep the shards from being closed until they have all been searched
+    pthread_rwlock_rdlock(&_searchLock);
+    NSArray *shards = [self openedShards];
+    NSUInteger count = [shards count];
+    if (count == 0) {
+        pthread_rwlock_unlock(&_searchLock);
+        return nil;
+    }
+
+    // One slot per shard, filled concurrently
+    id __strong *results = (id __strong *) MSMalloc(count * sizeof(id));
+    id __strong *errors = (id __strong *) MSMalloc(count * sizeof(id));
+    if (!results || !errors) {
+        MSFree(results);
+        MSFree(errors);
+        pthread_rwlock_unlock(&_searchLock);
+        return nil;
+    }
+    memset(results, 0, count * sizeof(id));
+    memset(errors, 0, count * sizeof(id));
+
+    dispatch_apply(count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        MSScanner *scanner = [shards objectAtIndex:i];
+        NSError *err = nil;
+        MSResult *res = nil;
+        if (options)
+            res = [scanner search2:qry options:options error:&err];
+        else
+            res = [scanner search:qry error:&err];
+        results[i] = [res retain_stub];
+        errors[i] = [err retain_stub];
+    });
+    pthread_rwlock_unlock(&_searchLock);
+
+    MSResult *result = nil;
+    MSScanner *winner = nil;
+    NSError *firstError = nil;
+    for (NSUInteger i = 0; i < count; i++) {
+        if (result == nil && results[i] != nil) {
+            result = [[results[i] retain_stub] autorelease_stub];
+            winner = [shards objectAtIndex:i];
+        }
+        if (firstError == nil && errors[i] != nil)
+            firstError = [[errors[i] retain_stub] autorelease_stub];
+        [results[i] release_stub];
+        [errors[i] release_stub];
+        results[i] = nil;
+        errors[i] = nil;
+    }
+    MSFree(results);
+    MSFree(errors);
+
+    if (winner != nil) {
+        @synchronized(self) {
+            NSUInteger index = 0;
+            for (MSScannerGroupShard *entry in _shards) {
+                if (entry->_scanner == winner) {
+                    entry->_lastHit = CFAbsoluteTimeGetCurrent();
+                    if (shard) *shard = index;
+                    break;
+                }
+                index++;
+            }
+        }
+    }
+
+    if (result == nil && firstError != nil && error)
+        *error = firstError;
+
+    return result;
+}
+
+#pragma mark - Private
+
+- (NSArray *)openedShards {
+    NSMutableArray *shards = [NSMutableArray array];
+    @synchronized(self) {
+        for (MSScannerGroupShard *entry in _shards) {
+            if (!entry->_parked) [shards addObject:entry->_scanner];
+        }
+    }
+    return shards;
+}
+
+- (MSScannerGroupShard *)entryForShard:(MSScanner *)shard {
+    @synchronized(self) {
+        for (MSScannerGroupShard *entry in _shards) {
+            if (entry->_scanner == shard) return entry;
+        }
+    }
+    return nil;
+}
+
+#pragma mark - NSNotifications
+
+- (void)applicationDidReceiveMemoryWarning:(void *)ignored {
+    [self releaseMemory];
+}
+
+@end
@@ -29,6 +29,10 @@
 #import "MSImage.h"
 #import "MSResult.h"
 #import "MSCaptureSession.h"
+#import "MSQuality.h"
+#import "MSResultCache.h"
+#import "MSFrameRecorder.h"
+#import "MSOnlineCache.h"
 #import "MSObjC.h"
 
 @protocol MSScannerSessionDelegate;
@@ -56,6 +60,14 @@ typedef enum {
     MSScanner *_scanner;
     BOOL _snap;
     MSScanState _state;
+    MSQualityThumb _gateThumb;
+    int _gateSkips;
+    uint64_t _qryHash;
+    BOOL _qryHashValid;
+    int _lastFormat;
+    uint64_t _snapHash;
+    BOOL _snapHashValid;
+    MSArena _arena;
 
 #if __has_feature(objc_arc_weak)
     id<MSScannerSessionDelegate> __weak _delegate;
@@ -122,6 +134,88 @@ typedef enum {
  * By default, this value is set to `NO`.
  */
 @property (nonatomic, assign) BOOL smallTargetSupport;
+/**
+ * The flag to skip frames that cannot produce a new result.
+ *
+ * Set this flag to `YES` to measure the sharpness of each frame and how much it
+ * differs from the last scanned frame before scanning it. Motion-blurred frames
+ * (see `minSharpness`) and frames taken while the camera is static (see `minMotion`)
+ * are not scanned: the delegate is notified with the current result instead, if any.
+ *
+ * This saves a lot of CPU when the device lies on a table or is being moved quickly.
+ *
+ * By default, this value is set to `NO`.
+ */
+@property (nonatomic, assign) BOOL skipLowQualityFrames;
+/**
+ * The sharpness (mean gradient energy, in the [0..255] range) under which a frame is
+ * considered as blurred and is skipped.
+ *
+ * By default, this value is set to 3.
+ */
+@property (nonatomic, assign) float minSharpness;
+/**
+ * The mean luminance difference with the last scanned frame (in the [0..255] range)
+ * under which the camera is considered as static and the frame is skipped.
+ *
+ * By default, this value is set to 1.5.
+ */
+@property (nonatomic, assign) float minMotion;
+/**
+ * The optional cache of recently recognized image results.
+ *
+ * When set, a frame that looks like a recently recognized one is first matched
+ * against the cached reference only, which is much cheaper than a full search.
+ * This speeds up recognition when the user re-aims at an item shortly after
+ * it has been lost. The cache can be shared among several sessions.
+ *
+ * By default, this value is `nil`.
+ */
+@property (nonatomic, strong) MSResultCache *resultCache;
+/**
+ * The optional recorder of the camera frames.
+ *
+ * When set, every frame received from the camera is written to the recorder
+ * before being processed, so that the session can later be replayed offline with
+ * `MSFrameReplayer`. Recording is expensive: only use it for testing purposes.
+ *
+ * By default, this value is `nil`.
+ */
+@property (nonatomic, strong) MSFrameRecorder *frameRecorder;
+/**
+ * The flag to send smaller queries to Moodstocks API.
+ *
+ * Set this flag to `YES` to make `snap` send a half-size grayscale version of the
+ * frame instead of the full frame. This lowers the upload time on slow connections,
+ * which otherwise may fail with `MS_SLOWCONN` or `MS_TIMEOUT`, at the expense of
+ * the recognition of small or far items.
+ *
+ * The query must be at least 480 pixels in its largest dimension: with capture
+ * presets smaller than 960 pixels, e.g. 640x480, the full frame is silently sent
+ * instead and this flag has no effect. Use `[MSFrameReplayer apiBenchmarkWithScanner:error:]`
+ * to compare both modes on recorded frames.
+ *
+ * By default, this value is set to `NO`.
+ */
+@property (nonatomic, assign) BOOL compactApiQuery;
+/**
+ * The optional persistent cache of the IDs recognized by Moodstocks API.
+ *
+ * When set, each `snap` is first looked up in this cache: if the frame looks like
+ * a previously snapped one and it matches on-device the ID it was recognized as,
+ * which requires this ID to be part of the local database, no API search is
+ * performed. Otherwise, the frame is sent to the API and the result is added to
+ * the cache.
+ *
+ * By default, this value is `nil`.
+ */
+@property (nonatomic, strong) MSOnlineCache *onlineCache;
+/** The number of frames that have been scanned.
+ */
+@property (nonatomic, readonly) NSUInteger scannedFrames;
+/** The number of frames that have been skipped by `skipLowQualityFrames`.
+ */
+@property (nonatomic, readonly) NSUInteger skippedFrames;
 
 ///---------------------------------------------------------------------------------------
 /// @name Initialization Methods
@@ -22,11 +22,32 @@
  */
 
 #import "MSScannerSession.h"
+#import "MSTrace.h"
+
+// Maximum number of consecutive frames skipped because the camera is static
+static const int kMSMaxStaticSkips = 15;
+
+// Margin added around the previous barcode location, as a ratio of its size
+static const float kMSHintMargin = 0.5f;
+
+// Smallest image dimension accepted by the scanner
+static const float kMSHintMinSize = 480.0f;
 
 @interface MSScannerSession ()
 
 - (MSResult *)scan:(MSImage *)qry options:(int)options error:(NSError **)error;
 - (void)reset;
+- (void)applicationDidReceiveMemoryWarning:(void *)ignored;
+#if MS_IPHONE_OS_REQUIREMENTS
+- (BOOL)analyzeBuffer:(CMSampleBufferRef)sampleBuffer
+                thumb:(MSQualityThumb *)thumb
+            sharpness:(float *)sharpness
+               motion:(float *)motion;
+- (BOOL)shouldSkipWithSharpness:(float)sharpness motion:(float)motion;
+- (MSResult *)rescanLockedBarcode:(CMSampleBufferRef)sampleBuffer
+                      orientation:(AVCaptureVideoOrientation)orientation;
+- (MSResult *)searchOnlineCache:(CMSampleBufferRef)sampleBuffer query:(MSImage *)qry;
+#endif
 
 @end
 
@@ -52,16 +73,45 @@
         _scanner = scanner;
         _captureSession = [[MSCaptureSession alloc] initWithDevice:device];
         _delegate = nil;
+        _gateThumb.valid = 0;
+        _gateSkips = 0;
+        _minSharpness = 3.0f;
+        _minMotion = 1.5f;
+        _scannedFrames = 0;
+        _skippedFrames = 0;
+        _qryHashValid = NO;
+        _resultCache = nil;
+        _frameRecorder = nil;
+        _compactApiQuery = NO;
+        _onlineCache = nil;
+        _snapHashValid = NO;
+        MSArenaInit(&_arena);
+        _lastFormat = MS_RESULT_TYPE_NONE;
+
+#if MS_IPHONE_OS_REQUIREMENTS
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(applicationDidReceiveMemoryWarning:)
+                                                     name:UIApplicationDidReceiveMemoryWarningNotification
+                                                   object:nil];
+#endif
     }
     return self;
 }
 
 - (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+
     [_result release_stub];
     _result = nil;
 
     [_captureSession release_stub];
 
+    [_resultCache release_stub];
+    [_frameRecorder release_stub];
+    [_onlineCache release_stub];
+
+    MSArenaDestroy(&_arena);
+
     _delegate = nil;
 
 #if ! __has_feature(objc_arc)
@@ -74,6 +124,9 @@
     _result = nil;
     _losts = 0;
     _snap = NO;
+    _gateThumb.valid = 0;
+    _gateSkips = 0;
+    _lastFormat = MS_RESULT_TYPE_NONE;
 }
 
 - (CALayer *)previewLayer {
@@ -145,6 +198,7 @@
             // The current frame matches with the previous result
             lock = YES;
             _losts = 0;
+            [_scanner recordEarlyExit:MS_EXIT_LOCK];
         }
         else if (found == -1) {
             // The current frame looks different so release the lock
@@ -169,14 +223,39 @@
     // Image search
     // -------------------------------------------------
     if (result == nil && (options & MS_RESULT_TYPE_IMAGE)) {
-        NSError *err  = nil;
-        if (flags)
-            result = [_scanner search2:qry options:flags error:&err];
-        else
-            result = [_scanner search:qry error:&err];
-        if (err != nil && [err code] != MS_EMPTY) {
-            if (error) *error = err;
-            return nil;
+        BOOL cached = (_resultCache != nil && _qryHashValid);
+        CFAbsoluteTime t0 = CFAbsoluteTimeGetCurrent();
+
+        // Near-duplicate of a recent result: verify against this reference only
+        if (cached) {
+            MSResult *ref = [_resultCache resultForHash:_qryHash];
+            if (ref != nil) {
+                if (flags)
+                    result = [_scanner match2:qry ref:ref options:flags error:nil];
+                else
+                    result = [_scanner match:qry ref:ref error:nil];
+            }
+            if (result != nil) {
+                [_resultCache recordHit:YES latency:(CFAbsoluteTimeGetCurrent() - t0)];
+                [_scanner recordEarlyExit:MS_EXIT_CACHE];
+            }
+        }
+
+        if (result == nil) {
+            NSError *err  = nil;
+            if (flags)
+                result = [_scanner search2:qry options:flags error:&err];
+            else
+                result = [_scanner search:qry error:&err];
+            if (err != nil && [err code] != MS_EMPTY) {
+                if (error) *error = err;
+                return nil;
+            }
+            if (cached) {
+                [_resultCache recordHit:NO latency:(CFAbsoluteTimeGetCurrent() - t0)];
+                if (result != nil)
+                    [_resultCache addResult:result forHash:_qryHash];
+            }
         }
         if (result != nil) {
             _losts = 0;
@@ -188,12 +267,24 @@
     // -------------------------------------------------
     if (result == nil) {
         NSError *err  = nil;
-        result = [_scanner decode:qry formats:options error:&err];
+        int formats = options & ~MS_RESULT_TYPE_IMAGE;
+
+        // Barcodes come in series: try the format decoded last time alone first
+        // so that the other decoders do not run when it is found again.
+        int first = formats & _lastFormat;
+        if (first) {
+            result = [_scanner decode:qry formats:first error:&err];
+            formats &= ~first;
+        }
+        if (result == nil && err == nil && formats) {
+            result = [_scanner decode:qry formats:formats error:&err];
+        }
         if (err != nil) {
             if (error) *error = err;
             return nil;
         }
         if (result != nil) {
+            _lastFormat = [result getType];
             _losts = 0;
         }
     }
@@ -222,22 +313,194 @@
 #pragma mark - MSCaptureSessionDelegate
 
 #if MS_IPHONE_OS_REQUIREMENTS
+- (BOOL)analyzeBuffer:(CMSampleBufferRef)sampleBuffer
+                thumb:(MSQualityThumb *)thumb
+            sharpness:(float *)sharpness
+               motion:(float *)motion {
+    CVImageBufferRef imageBuffer = CMSampleBufferGetImageBuffer(sampleBuffer);
+    if (CVPixelBufferGetPixelFormatType(imageBuffer) != kCVPixelFormatType_32BGRA)
+        return NO;
+
+    CVPixelBufferLockBaseAddress(imageBuffer, 0);
+    int err = MSImageQuality(CVPixelBufferGetBaseAddress(imageBuffer),
+                             (int) CVPixelBufferGetWidth(imageBuffer),
+                             (int) CVPixelBufferGetHeight(imageBuffer),
+                             (int) CVPixelBufferGetBytesPerRow(imageBuffer),
+                             MS_PIX_FMT_RGB32, &_gateThumb,
+                             sharpness, motion, thumb);
+    CVPixelBufferUnlockBaseAddress(imageBuffer, 0);
+    return !err;
+}
+
+- (BOOL)shouldSkipWithSharpness:(float)sharpness motion:(float)motion {
+    // Blurred frame: keep the previous frame as reference
+    if (sharpness < _minSharpness)
+        return YES;
+
+    // Static camera: the previous scan outcome still holds
+    if (motion >= 0 && motion < _minMotion && _gateSkips < kMSMaxStaticSkips) {
+        _gateSkips++;
+        return YES;
+    }
+
+    _gateSkips = 0;
+    return NO;
+}
+
+- (MSResult *)rescanLockedBarcode:(CMSampleBufferRef)sampleBuffer
+                      orientation:(AVCaptureVideoOrientation)orientation {
+    if (_result == nil || _losts >= 2) return nil;
+
+    int type = [_result getType];
+    if (type != MS_RESULT_TYPE_QRCODE && type != MS_RESULT_TYPE_DMTX) return nil;
+
+    CGPoint corners[4];
+    if (![_result getCorners:corners]) return nil;
+
+    CVImageBufferRef imageBuffer = CMSampleBufferGetImageBuffer(sampleBuffer);
+    float width = CVPixelBufferGetWidth(imageBuffer);
+    float height = CVPixelBufferGetHeight(imageBuffer);
+
+    // Bounding box of the previous location, in pixels, with a margin for motion
+    float x0 = width, y0 = height, x1 = 0, y1 = 0;
+    for (int i = 0; i < 4; ++i) {
+        float x = (corners[i].x + 1) * width / 2;
+        float y = (corners[i].y + 1) * height / 2;
+        x0 = MIN(x0, x); x1 = MAX(x1, x);
+        y0 = MIN(y0, y); y1 = MAX(y1, y);
+    }
+    CGRect crop = CGRectInset(CGRectMake(x0, y0, x1 - x0, y1 - y0),
+                              -kMSHintMargin * (x1 - x0), -kMSHintMargin * (y1 - y0));
+
+    // Grow the region up to the smallest size accepted by the scanner
+    if (crop.size.width < kMSHintMinSize && crop.size.height < kMSHintMinSize) {
+        if (width >= height)
+            crop = CGRectInset(crop, (crop.size.width - kMSHintMinSize) / 2, 0);
+        else
+            crop = CGRectInset(crop, 0, (crop.size.height - kMSHintMinSize) / 2);
+    }
+    if (crop.origin.x < 0) crop.origin.x = 0;
+    if (crop.origin.y < 0) crop.origin.y = 0;
+    if (CGRectGetMaxX(crop) > width) crop.origin.x = MAX(0, width - crop.size.width);
+    if (CGRectGetMaxY(crop) > height) crop.origin.y = MAX(0, height - crop.size.height);
+    crop = CGRectIntersection(crop, CGRectMake(0, 0, width, height));
+
+    // Not worth it if the barcode fills most of the frame
+    if (crop.size.width * crop.size.height > 0.5f * width * height) return nil;
+
+    MS_STATS_SCANNER_BEGIN(_scanner, t0);
+    MSImage *hint = [[MSImage alloc] initWithBuffer:sampleBuffer orientation:orientation crop:crop];
+    MS_STATS_SCANNER_END(_scanner, MS_STAGE_INGEST, t0);
+    MSResult *result = nil;
+    if ([hint image] != NULL) {
+        result = [_scanner decode:hint formats:type error:nil];
+        if (![result isEqualToResult:_result])
+            result = nil;
+    }
+    [hint release_stub];
+
+    if (result != nil) {
+        _losts = 0;
+        [_result release_stub];
+        _result = [result copy];
+        [_scanner recordEarlyExit:MS_EXIT_HINT];
+    }
+    return result;
+}
+
+- (MSResult *)searchOnlineCache:(CMSampleBufferRef)sampleBuffer query:(MSImage *)qry {
+    _snapHashValid = NO;
+    if (_onlineCache == nil) return nil;
+
+    MSQualityThumb thumb;
+    float sharpness, motion;
+    if (![self analyzeBuffer:sampleBuffer thumb:&thumb sharpness:&sharpness motion:&motion])
+        return nil;
+    _snapHash = MSQualityHash(&thumb);
+    _snapHashValid = YES;
+
+    NSString *uid = [_onlineCache IDForHash:_snapHash];
+    if (uid == nil) return nil;
+
+    // The descriptor only designates a candidate: confirm it on-device. This only
+    // succeeds once the item has been synced to the local database.
+    return [_scanner match:qry uid:uid error:nil];
+}
+
 - (void)session:(MSCaptureSession *)session didOutputSampleBuffer:(CMSampleBufferRef)sampleBuffer {
+    AVCaptureVideoOrientation orientation = (self.useDeviceOrientation) ? session.orientation : AVCaptureVideoOrientationPortrait;
+
+    if (_frameRecorder != nil)
+        [_frameRecorder recordBuffer:sampleBuffer orientation:orientation];
+
+    // Scratch buffers only live for one frame
+    MSArenaReset(&_arena);
+
     if (_state != MS_SCAN_STATE_DEFAULT) return;
 
-    AVCaptureVideoOrientation orientation = (self.useDeviceOrientation) ? session.orientation : AVCaptureVideoOrientationPortrait;
-    MSImage *qry = [[MSImage alloc] initWithBuffer:sampleBuffer orientation:orientation];
+    _qryHashValid = NO;
+    if (!_snap && (self.skipLowQualityFrames || _resultCache != nil)) {
+        MSQualityThumb thumb;
+        float sharpness, motion;
+        MS_TRACE_BEGIN("gate");
+        BOOL analyzed = [self analyzeBuffer:sampleBuffer thumb:&thumb sharpness:&sharpness motion:&motion];
+        MS_TRACE_END("gate");
+        if (analyzed) {
+            if (self.skipLowQualityFrames && [self shouldSkipWithSharpness:sharpness motion:motion]) {
+                _skippedFrames++;
+                [_scanner recordEarlyExit:MS_EXIT_GATE];
+                [_delegate session:self didScan:[[_result copy] autorelease_stub]];
+                return;
+            }
+            _gateThumb = thumb;
+            _qryHash = MSQualityHash(&thumb);
+            _qryHashValid = YES;
+        }
+    }
 
     if (_snap) {
+        MSImage *qry = nil;
+        if (self.compactApiQuery)
+            qry = [[MSImage alloc] initWithHalfSizeBuffer:sampleBuffer orientation:orientation arena:&_arena];
+        else
+            qry = [[MSImage alloc] initWithBuffer:sampleBuffer orientation:orientation];
         _snap = NO;
         _state = MS_SCAN_STATE_SEARCH;
-        [_scanner apiSearch:qry withDelegate:self];
+        MSResult *cached = [self searchOnlineCache:sampleBuffer query:qry];
+        if (cached != nil) {
+            // Report it the same way as an API search result
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [self scannerWillSearch:_scanner];
+                [self scanner:_scanner didSearchWithResult:cached];
+            });
+        }
+        else {
+            [_scanner apiSearch:qry withDelegate:self];
+        }
         [qry release_stub];
         return;
     }
 
     NSError *error = nil;
-    MSResult *result = [self scan:qry options:_scanOptions error:&error];
+    _scannedFrames++;
+    MSResult *previous = [_result retain_stub];
+
+    // A locked 2D barcode is first searched where it was last seen, and the whole
+    // frame is only scanned if it could not be found there.
+    MS_TRACE_BEGIN("hint");
+    MSResult *result = [self rescanLockedBarcode:sampleBuffer orientation:orientation];
+    MS_TRACE_END("hint");
+    if (result == nil) {
+        MS_TRACE_BEGIN("ingest");
+        MS_STATS_SCANNER_BEGIN(_scanner, t0);
+        MSImage *qry = [[MSImage alloc] initWithBuffer:sampleBuffer orientation:orientation];
+        MS_STATS_SCANNER_END(_scanner, MS_STAGE_INGEST, t0);
+        MS_TRACE_END("ingest");
+        MS_TRACE_BEGIN("scan");
+        result = [self scan:qry options:_scanOptions error:&error];
+        MS_TRACE_END("scan");
+        [qry release_stub];
+    }
     if (!error) {
         if (result) {
             if (_extras & MS_RESULT_EXTRA_IMAGE) {
@@ -245,16 +508,41 @@
                 [result setImage:frame withOrientation:orientation];
                 CGImageRelease(frame);
             }
+            if ((_extras & MS_RESULT_EXTRA_WARPED) && [result getType] == MS_RESULT_TYPE_IMAGE &&
+                ![result isEqualToResult:previous]) {
+                // Warp while the frame is at hand: no CGImage conversion nor copy. This
+                // is only done for new results since the warp costs a full-size render.
+                float homog[9];
+                CGSize dims;
+                if ([result getHomography:homog] && [result getDimensions:&dims]) {
+                    ms_warp_data_t data = { .homography = homog,
+                                            .width = dims.width,
+                                            .height = dims.height };
+                    CGImageRef warped = [MSImage newWarpFromBuffer:sampleBuffer data:&data scale:-1 gray:NO];
+                    if (warped) {
+                        [result setWarped:warped];
+                        CGImageRelease(warped);
+                    }
+                }
+            }
         }
+        MS_TRACE_BEGIN("delegate");
         [_delegate session:self didScan:result];
+        MS_TRACE_END("delegate");
     }
     else if ([_delegate respondsToSelector:@selector(session:failedToScan:)])
         [_delegate performSelector:@selector(session:failedToScan:) withObject:error];
-
-    [qry release_stub];
+    [previous release_stub];
 }
 #endif
 
+#pragma mark - NSNotifications
+
+- (void)applicationDidReceiveMemoryWarning:(void *)ignored {
+    // Cached results are cheap to rebuild with a few full searches
+    [_resultCache removeAllResults];
+}
+
 #pragma mark - MSScannerDelegate
 
 - (void)scannerWillSearch:(MSScanner *)scanner {
@@ -268,6 +556,10 @@
 - (void)scanner:(MSScanner *)scanner didSearchWithResult:(MSResult *)result {
     _state = MS_SCAN_STATE_DEFAULT;
 
+    if (result != nil && _snapHashValid && [result getType] == MS_RESULT_TYPE_IMAGE)
+        [_onlineCache addID:[result getValue] forHash:_snapHash];
+    _snapHashValid = NO;
+
     if ([_delegate respondsToSelector:@selector(scanner:didSearchWithResult:)]) {
         [_delegate scanner:_scanner didSearchWithResult:result];
     }
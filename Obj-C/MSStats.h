@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+
+/** Compile-time switch for the scanner statistics.
+ *
+ * Define `MS_STATS` to 0 to compile out all timing and counting code. When compiled
+ * in, statistics are still disabled by default and must be enabled at runtime (see
+ * `[MSScanner statsEnabled]`).
+ */
+#ifndef MS_STATS
+  #define MS_STATS 1
+#endif
+
+/** Timed processing stages.
+ */
+typedef enum {
+    MS_STAGE_INGEST = 0,    /* camera frame to scanner image conversion */
+    MS_STAGE_SEARCH,        /* on-device image search */
+    MS_STAGE_MATCH,         /* on-device image matching against one reference */
+    MS_STAGE_DECODE,        /* barcode decoding */
+    MS_STAGE_API_SEARCH,    /* server-side image search */
+    MS_STAGE_NB             /* number of stages - do not use! */
+} MSStage;
+
+/** Frames that have been resolved without a full scan.
+ */
+typedef enum {
+    MS_EXIT_GATE = 0,       /* frame skipped by the quality gate */
+    MS_EXIT_LOCK,           /* result confirmed by matching the locked reference */
+    MS_EXIT_CACHE,          /* result found thanks to the result cache */
+    MS_EXIT_HINT,           /* barcode found again at its previous location */
+    MS_EXIT_NB              /* number of early exits - do not use! */
+} MSEarlyExit;
+
+/** Number of histogram buckets: bucket `k > 0` counts durations within
+ * [2^(k-1), 2^k) microseconds, the last one counts all longer durations.
+ */
+#define MS_STATS_BUCKETS 24
+
+/** Timings of a processing stage, in microseconds.
+ */
+typedef struct {
+    int64_t count;
+    int64_t total;
+    int64_t max;
+    int32_t buckets[MS_STATS_BUCKETS];
+} MSStageStats;
+
+/** Scanner statistics.
+ */
+typedef struct {
+    MSStageStats stages[MS_STAGE_NB];
+    int64_t exits[MS_EXIT_NB];
+} MSScannerStats;
+
+/** Get a monotonic timestamp, in microseconds.
+ */
+uint64_t MSStatsNow(void);
+
+/** Record the duration of a stage, thread-safely.
+ *
+ * @param stats the statistics to update.
+ * @param stage the stage that has been timed.
+ * @param start the timestamp at which the stage started, as returned by `MSStatsNow`.
+ */
+void MSStatsRecord(MSScannerStats *stats, MSStage stage, uint64_t start);
+
+/** Count an early exit, thread-safely.
+ *
+ * @param stats the statistics to update.
+ * @param exit the kind of early exit.
+ */
+void MSStatsExit(MSScannerStats *stats, MSEarlyExit exit);
+
+/** Copy statistics that may be updated concurrently.
+ *
+ * Each field is read atomically, but a stage being recorded meanwhile may only be
+ * partly accounted for, e.g. in its count but not yet in its histogram.
+ *
+ * @param dst the statistics to fill.
+ * @param src the statistics to copy.
+ */
+void MSStatsCopy(MSScannerStats *dst, MSScannerStats *src);
+
+/** Reset statistics that may be updated concurrently, one field at a time.
+ *
+ * @param stats the statistics to reset.
+ */
+void MSStatsReset(MSScannerStats *stats);
+
+/** Get the median, or any other percentile, of a stage duration from its histogram.
+ *
+ * @param stage the stage statistics.
+ * @param p the percentile, in the [0..1] range.
+ * @return the upper bound of the bucket holding the percentile, in microseconds.
+ */
+int64_t MSStatsPercentile(const MSStageStats *stage, float p);
+
+/** Instrumentation helpers, compiled out along with the statistics.
+ */
+#if MS_STATS
+  #define MS_STATS_BEGIN(MS_enabled, MS_t) \
+    uint64_t MS_t = (MS_enabled) ? MSStatsNow() : 0
+  #define MS_STATS_END(MS_enabled, MS_stats, MS_stage, MS_t) \
+    do { if (MS_enabled) MSStatsRecord((MS_stats), (MS_stage), (MS_t)); } while (0)
+#else
+  #define MS_STATS_BEGIN(MS_enabled, MS_t) ((void)0)
+  #define MS_STATS_END(MS_enabled, MS_stats, MS_stage, MS_t) ((void)0)
+#endif
@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "MSStats.h"
+
+#include <libkern/OSAtomic.h>
+#include <mach/mach_time.h>
+
+uint64_t MSStatsNow(void) {
+    static mach_timebase_info_data_t timebase;
+    if (timebase.denom == 0)
+        mach_timebase_info(&timebase);
+    return (mach_absolute_time() * timebase.numer) / (timebase.denom * 1000);
+}
+
+void MSStatsRecord(MSScannerStats *stats, MSStage stage, uint64_t start) {
+    int64_t us = (int64_t) (MSStatsNow() - start);
+    MSStageStats *st = &stats->stages[stage];
+
+    int k = 0;
+    while (k < MS_STATS_BUCKETS - 1 && (1LL << k) <= us)
+        k++;
+
+    OSAtomicIncrement64(&st->count);
+    OSAtomicAdd64(us, &st->total);
+    OSAtomicIncrement32(&st->buckets[k]);
+
+    int64_t max = st->max;
+    while (us > max && !OSAtomicCompareAndSwap64(max, us, &st->max))
+        max = st->max;
+}
+
+void MSStatsExit(MSScannerStats *stats, MSEarlyExit exit) {
+    OSAtomicIncrement64(&stats->exits[exit]);
+}
+
+void MSStatsCopy(MSScannerStats *dst, MSScannerStats *src) {
+    for (int i = 0; i < MS_STAGE_NB; i++) {
+        MSStageStats *s = &src->stages[i], *d = &dst->stages[i];
+        d->count = OSAtomicAdd64(0, &s->count);
+        d->total = OSAtomicAdd64(0, &s->total);
+        d->max = OSAtomicAdd64(0, &s->max);
+        for (int k = 0; k < MS_STATS_BUCKETS; k++)
+            d->buckets[k] = OSAtomicAdd32(0, &s->buckets[k]);
+    }
+    for (int i = 0; i < MS_EXIT_NB; i++)
+        dst->exits[i] = OSAtomicAdd64(0, &src->exits[i]);
+}
+
+static void ms_stats_clear64(int64_t *v) {
+    int64_t old;
+    do {
+        old = *v;
+    } while (!OSAtomicCompareAndSwap64(old, 0, v));
+}
+
+static void ms_stats_clear32(int32_t *v) {
+    int32_t old;
+    do {
+        old = *v;
+    } while (!OSAtomicCompareAndSwap32(old, 0, v));
+}
+
+void MSStatsReset(MSScannerStats *stats) {
+    for (int i = 0; i < MS_STAGE_NB; i++) {
+        MSStageStats *st = &stats->stages[i];
+        ms_stats_clear64(&st->count);
+        ms_stats_clear64(&st->total);
+        ms_stats_clear64(&st->max);
+        for (int k = 0; k < MS_STATS_BUCKETS; k++)
+            ms_stats_clear32(&st->buckets[k]);
+    }
+    for (int i = 0; i < MS_EXIT_NB; i++)
+        ms_stats_clear64(&stats->exits[i]);
+}
+
+int64_t MSStatsPercentile(const MSStageStats *stage, float p) {
+    int64_t total = 0;
+    for (int k = 0; k < MS_STATS_BUCKETS; k++)
+        total += stage->buckets[k];
+    if (total == 0)
+        return 0;
+
+    int64_t rank = (int64_t) (p * total), seen = 0;
+    for (int k = 0; k < MS_STATS_BUCKETS - 1; k++) {
+        seen += stage->buckets[k];
+        if (seen > rank)
+            return 1LL << k;
+    }
+    return stage->max;
+}
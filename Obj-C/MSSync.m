@@ -25,6 +25,7 @@
 
 #import "MSSync.h"
 #import "MSObjC.h"
+#import "MSTrace.h"
 
 @interface MSSync ()
 @property (nonatomic, assign) int current;
@@ -62,7 +63,8 @@ static int mssync_progress_cb(void *opq, int total, int current) {
 - (id)initWithScanner:(MSScanner *)scanner {
     self = [super init];
     if (self) {
-        _scanner = scanner;
+        // Keep the scanner alive as long as the synchronization may use it
+        _scanner = [scanner retain_stub];
         _delegate = nil;
         self.current = 0;
         self.total = -1;
@@ -72,6 +74,7 @@ static int mssync_progress_cb(void *opq, int total, int current) {
 }
 
 - (void)dealloc {
+    [_scanner release_stub];
     _scanner = nil;
     _delegate = nil;
     
@@ -116,7 +119,9 @@ static int mssync_progress_cb(void *opq, int total, int current) {
         void *opq = (void *) self;
 #endif
         
+        MS_TRACE_BEGIN("sync");
         ms_errcode ecode = ms_scanner_sync2([_scanner handle], mssync_progress_cb, opq);
+        MS_TRACE_END("sync");
         if (ecode != MS_SUCCESS) {
             error = [NSError errorWithDomain:@"moodstocks-sdk" code:ecode userInfo:nil];
         }
@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/** Compile-time switch for the scan tracer.
+ *
+ * Define `MS_TRACE` to 0 to compile out all trace points. When compiled in, tracing
+ * is still disabled by default and must be enabled at runtime with
+ * `MSTraceSetEnabled`.
+ */
+#ifndef MS_TRACE
+  #define MS_TRACE 1
+#endif
+
+/** Maximum number of events kept by the tracer (a power of 2): when it is full, the
+ * oldest events are overwritten.
+ */
+#define MS_TRACE_CAPACITY 16384
+
+/** Enable or disable tracing at runtime.
+ *
+ * @param enabled a non-zero value to start recording events, 0 to stop.
+ */
+void MSTraceSetEnabled(int enabled);
+
+/** Check whether tracing is enabled.
+ *
+ * @return a non-zero value if tracing is enabled, 0 otherwise.
+ */
+int MSTraceIsEnabled(void);
+
+/** Record the beginning of a stage on the calling thread.
+ *
+ * This function is lock-free and can be called from any thread.
+ *
+ * @param name the stage name. It must be a string literal, since only the pointer
+ * is kept.
+ */
+void MSTraceBegin(const char *name);
+
+/** Record the end of a stage on the calling thread.
+ *
+ * @param name the stage name, as passed to `MSTraceBegin`.
+ */
+void MSTraceEnd(const char *name);
+
+/** Drop all recorded events.
+ */
+void MSTraceClear(void);
+
+/** Write the recorded events to a file in the Chrome Trace Event JSON format.
+ *
+ * The resulting file can be loaded into `chrome://tracing` or Perfetto to display
+ * a per-thread timeline of the scan sessions. Events recorded while dumping may be
+ * missing from the output.
+ *
+ * @param path the path of the file to write.
+ * @return 0 if the file could be written, 1 otherwise.
+ */
+int MSTraceDump(const char *path);
+
+/** Trace points, compiled out along with the tracer.
+ */
+#if MS_TRACE
+  #define MS_TRACE_BEGIN(MS_name) MSTraceBegin(MS_name)
+  #define MS_TRACE_END(MS_name) MSTraceEnd(MS_name)
+#else
+  #define MS_TRACE_BEGIN(MS_name) ((void)0)
+  #define MS_TRACE_END(MS_name) ((void)0)
+#endif
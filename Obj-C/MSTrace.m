@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2013 Moodstocks SAS
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "MSTrace.h"
+
+#include <libkern/OSAtomic.h>
+#include <mach/mach_time.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/** A trace event. `seq` is set last, to the event index + 1, once the slot has been
+ * completely written.
+ */
+typedef struct {
+    volatile int64_t seq;
+    const char *name;
+    uint64_t ts;
+    uint32_t tid;
+    char phase;
+} ms_trace_event_t;
+
+static ms_trace_event_t gMSTraceEvents[MS_TRACE_CAPACITY];
+static volatile int64_t gMSTraceHead = 0;
+static volatile int gMSTraceEnabled = 0;
+
+static uint64_t ms_trace_now(void) {
+    static mach_timebase_info_data_t timebase;
+    if (timebase.denom == 0)
+        mach_timebase_info(&timebase);
+    return (mach_absolute_time() * timebase.numer) / (timebase.denom * 1000);
+}
+
+static void ms_trace_record(const char *name, char phase) {
+    if (!gMSTraceEnabled) return;
+
+    int64_t idx = OSAtomicIncrement64(&gMSTraceHead) - 1;
+    ms_trace_event_t *ev = &gMSTraceEvents[idx & (MS_TRACE_CAPACITY - 1)];
+    ev->seq = 0;
+    OSMemoryBarrier();
+    ev->name = name;
+    ev->ts = ms_trace_now();
+    ev->tid = pthread_mach_thread_np(pthread_self());
+    ev->phase = phase;
+    OSMemoryBarrier();
+    ev->seq = idx + 1;
+}
+
+void MSTraceSetEnabled(int enabled) {
+    gMSTraceEnabled = enabled ? 1 : 0;
+}
+
+int MSTraceIsEnabled(void) {
+    return gMSTraceEnabled;
+}
+
+void MSTraceBegin(const char *name) {
+    ms_trace_record(name, 'B');
+}
+
+void MSTraceEnd(const char *name) {
+    ms_trace_record(name, 'E');
+}
+
+void MSTraceClear(void) {
+    for (int i = 0; i < MS_TRACE_CAPACITY; i++)
+        gMSTraceEvents[i].seq = 0;
+    OSMemoryBarrier();
+}
+
+int MSTraceDump(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) return 1;
+
+    int64_t head = gMSTraceHead;
+    int64_t first = (head > MS_TRACE_CAPACITY) ? head - MS_TRACE_CAPACITY : 0;
+    int sep = 0;
+
+    fprintf(f, "{\"traceEvents\":[");
+    for (int64_t idx = first; idx < head; idx++) {
+        ms_trace_event_t ev = gMSTraceEvents[idx & (MS_TRACE_CAPACITY - 1)];
+        OSMemoryBarrier();
+        // Skip slots being written or already overwritten
+        if (ev.seq != idx + 1 || gMSTraceEvents[idx & (MS_TRACE_CAPACITY - 1)].seq != ev.seq)
+            continue;
+        fprintf(f, "%s\n{\"name\":\"%s\",\"cat\":\"moodstocks\",\"ph\":\"%c\","
+                   "\"ts\":%llu,\"pid\":1,\"tid\":%u}",
+                sep ? "," : "", ev.name, ev.phase,
+                (unsigned long long) ev.ts, (unsigned) ev.tid);
+        sep = 1;
+    }
+    fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+    return fclose(f) == 0 ? 0 : 1;
+}